@@ -7,6 +7,9 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include <round.h>
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -32,6 +35,32 @@
 #define STA_BSY 0x80  /* Busy. */
 #define STA_DRDY 0x40 /* Device Ready. */
 #define STA_DRQ 0x08  /* Data Request. */
+#define STA_ERR 0x01  /* Error. */
+
+/* Bus-master IDE registers, relative to the channel's base in the
+   controller's BAR4 (SFF-8038i). */
+#define bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)	 /* Status. */
+#define bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)	 /* PRD table address. */
+
+/* Bus-master Command and Status Register bits. */
+#define BM_CMD_START 0x01 /* Start transfer. */
+#define BM_CMD_READ 0x08  /* Transfer from disk to memory. */
+#define BM_STA_ERR 0x02	  /* Error. */
+#define BM_STA_IRQ 0x04	  /* Interrupt raised. */
+
+/* PCI configuration space access, just enough to find the IDE
+   controller's bus-master registers. */
+#define PCI_CONFIG_ADDRESS 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+#define PCI_ID 0x00
+#define PCI_COMMAND 0x04
+#define PCI_CLASS 0x08
+#define PCI_BAR4 0x20
+#define PCI_CMD_IO 0x01			   /* Respond to I/O space accesses. */
+#define PCI_CMD_BUS_MASTER 0x04	   /* May act as a bus master. */
+#define PCI_CLASS_IDE 0x0101	   /* Mass storage, IDE. */
+#define PCI_PROGIF_BUS_MASTER 0x80 /* Programming interface: bus master. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04 /* Software Reset. */
@@ -47,6 +76,38 @@
 #define CMD_IDENTIFY_DEVICE 0xec	/* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20	/* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30 /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4		/* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5		/* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6	/* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8			/* READ DMA. */
+#define CMD_WRITE_DMA 0xca			/* WRITE DMA. */
+
+/* Most sectors moved by one command: a sector count of 0 means
+   256. */
+#define MAX_XFER_SECTORS 256
+
+/* Largest DRQ block we ask for with SET MULTIPLE MODE. */
+#define MAX_MULTIPLE 16
+
+/* Most sectors in one batch of merged requests, and the PRD
+   entries a DMA batch may take, one per page piece of a buffer. */
+#define MAX_BATCH_SECTORS 128
+#define PRD_CNT 32
+
+/* Ticks a request may wait before it is served ahead of the
+   elevator order. */
+#define DISK_DEADLINE (TIMER_FREQ / 2)
+
+/* A Physical Region Descriptor: one physically contiguous piece of
+   a DMA buffer.  It may not cross a 64 kB boundary, which a piece
+   within one page never does. */
+struct prd
+{
+	uint32_t addr;	/* Physical address. */
+	uint16_t size;	/* Byte count, 0 meaning 64 kB. */
+	uint16_t flags; /* PRD_EOT on the last entry. */
+};
+#define PRD_EOT 0x8000
 
 /* An ATA device. */
 struct disk
@@ -57,6 +118,9 @@ struct disk
 
 	bool is_ata;			/* 1=This device is an ATA disk. */
 	disk_sector_t capacity; /* Capacity in sectors (if is_ata). */
+	int multiple;			/* Sectors per DRQ block with READ/WRITE
+							   MULTIPLE, or 1 if not supported. */
+	bool dma;				/* Supports DMA transfers? */
 
 	long long read_cnt;	 /* Number of sectors read. */
 	long long write_cnt; /* Number of sectors written. */
@@ -70,29 +134,76 @@ struct channel
 	uint16_t reg_base; /* Base I/O port. */
 	uint8_t irq;	   /* Interrupt in use. */
 
-	struct lock lock;				  /* Must acquire to access the controller. */
 	bool expecting_interrupt;		  /* True if an interrupt is expected, false if
 										 any interrupt would be spurious. */
-	struct semaphore completion_wait; /* Up'd by interrupt handler. */
+	struct semaphore completion_wait; /* Up'd by interrupt handler while
+										 no request is active. */
 
 	struct disk devices[2]; /* The devices on this channel. */
+
+	/* Request queue, guarded by disabling interrupts. */
+	struct list queue;		 /* Submitted, not yet started. */
+	struct list active;		 /* The batch in progress, in sector order. */
+	disk_sector_t head;		 /* Sector after the last batch started. */
+	struct disk *xfer_disk;	 /* Disk of the active batch. */
+	bool xfer_write;		 /* Active batch writes? */
+	bool xfer_dma;			 /* Active batch uses DMA? */
+	size_t xfer_cnt;		 /* Sectors in the active batch. */
+	size_t xfer_done;		 /* PIO: sectors moved so far. */
+	struct list_elem *cursor; /* PIO: request of the next sector... */
+	size_t cursor_ofs;		 /* ...and its index in that request. */
+
+	struct semaphore dispatch_wait; /* Up'd when the dispatcher may have
+									   a batch to start. */
+
+	/* Busy/idle accounting, in timer ticks. */
+	int64_t busy_since;	 /* When the active batch started. */
+	int64_t busy_ticks;	 /* Total time with a batch active. */
+	long long batch_cnt; /* Batches started. */
+
+	uint16_t bm_base; /* Bus-master registers, 0 if PIO only. */
+
+	/* PRD table.  Aligning it to its size keeps it from crossing a
+	   64 kB boundary, as the controller requires. */
+	struct prd prd[PRD_CNT] __attribute__((aligned(PRD_CNT * 8)));
 };
 
 /* We support the two "legacy" ATA channels found in a standard PC. */
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
+/* Channel-wide accounting, guarded by disabling interrupts. */
+static int64_t stats_start;	  /* When accounting began. */
+static int busy_channels;	  /* Channels with a batch active. */
+static int64_t overlap_since; /* When the last channel went busy. */
+static int64_t overlap_ticks; /* Total time with every channel busy. */
+
 static void reset_channel(struct channel *);
 static bool check_device_type(struct disk *);
 static void identify_ata_device(struct disk *);
 
-static void select_sector(struct disk *, disk_sector_t);
+static void set_multiple_mode(struct disk *, int max);
+
+static void disk_transfer(struct disk *, disk_sector_t, void *, size_t cnt, bool write);
+static void channel_dispatcher(void *);
+static void channel_dispatch(struct channel *);
+static void account_busy(struct channel *, bool busy);
+static void channel_interrupt(struct channel *);
+static void pio_start(struct channel *, disk_sector_t);
+static void dma_start(struct channel *, disk_sector_t);
+static uint16_t find_bus_master(void);
+static uint32_t pci_read(int dev, int func, uint8_t reg);
+static void pci_write(int dev, int func, uint8_t reg, uint32_t value);
+
+static void select_sector(struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command(struct channel *, uint8_t command);
+static void issue_command(struct channel *, uint8_t command);
 static void input_sector(struct channel *, void *);
 static void output_sector(struct channel *, const void *);
 
 static void wait_until_idle(const struct disk *);
 static bool wait_while_busy(const struct disk *);
+static bool wait_for_drq(const struct disk *);
 static void select_device(const struct disk *);
 static void select_device_wait(const struct disk *);
 
@@ -102,6 +213,7 @@ static void interrupt_handler(struct intr_frame *);
 void disk_init(void)
 {
 	size_t chan_no;
+	uint16_t bm_base = find_bus_master();
 
 	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
 	{
@@ -123,9 +235,15 @@ void disk_init(void)
 		default:
 			NOT_REACHED();
 		}
-		lock_init(&c->lock);
+		c->bm_base = bm_base != 0 ? bm_base + chan_no * 8 : 0;
 		c->expecting_interrupt = false;
 		sema_init(&c->completion_wait, 0);
+		list_init(&c->queue);
+		list_init(&c->active);
+		c->head = 0;
+		sema_init(&c->dispatch_wait, 0);
+		c->busy_ticks = 0;
+		c->batch_cnt = 0;
 
 		/* Initialize devices. */
 		for (dev_no = 0; dev_no < 2; dev_no++)
@@ -137,6 +255,8 @@ void disk_init(void)
 
 			d->is_ata = false;
 			d->capacity = 0;
+			d->multiple = 1;
+			d->dma = false;
 
 			d->read_cnt = d->write_cnt = 0;
 		}
@@ -155,7 +275,13 @@ void disk_init(void)
 		for (dev_no = 0; dev_no < 2; dev_no++)
 			if (c->devices[dev_no].is_ata)
 				identify_ata_device(&c->devices[dev_no]);
+
+		/* Start the channel's dispatcher.  It outranks everything
+		   else so that an idle channel picks up work at once. */
+		if (thread_create(c->name, PRI_MAX, channel_dispatcher, c) == TID_ERROR)
+			PANIC("%s: dispatcher creation failed", c->name);
 	}
+	stats_start = timer_ticks();
 
 	/* DO NOT MODIFY BELOW LINES. */
 	register_disk_inspect_intr();
@@ -164,10 +290,19 @@ void disk_init(void)
 /* Prints disk statistics. */
 void disk_print_stats(void)
 {
+	enum intr_level old_level;
+	int64_t now, overlap;
 	int chan_no;
 
+	old_level = intr_disable();
+	now = timer_ticks();
+	overlap = overlap_ticks + (busy_channels == CHANNEL_CNT ? now - overlap_since : 0);
+	intr_set_level(old_level);
+
 	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
 	{
+		struct channel *c = &channels[chan_no];
+		int64_t busy;
 		int dev_no;
 
 		for (dev_no = 0; dev_no < 2; dev_no++)
@@ -177,7 +312,14 @@ void disk_print_stats(void)
 				printf("%s: %lld reads, %lld writes\n",
 					   d->name, d->read_cnt, d->write_cnt);
 		}
+
+		old_level = intr_disable();
+		busy = c->busy_ticks + (!list_empty(&c->active) ? now - c->busy_since : 0);
+		intr_set_level(old_level);
+		printf("%s: %lld batches, busy %lld ticks, idle %lld ticks\n",
+			   c->name, c->batch_cnt, (long long)busy, (long long)(now - stats_start - busy));
 	}
+	printf("Disk channels overlapped for %lld ticks\n", (long long)overlap);
 }
 
 /* Returns the disk numbered DEV_NO--either 0 or 1 for master or
@@ -219,21 +361,7 @@ disk_size(struct disk *d)
    per-disk locking is unneeded. */
 void disk_read(struct disk *d, disk_sector_t sec_no, void *buffer)
 {
-	struct channel *c;
-
-	ASSERT(d != NULL);
-	ASSERT(buffer != NULL);
-
-	c = d->channel;
-	lock_acquire(&c->lock);
-	select_sector(d, sec_no);
-	issue_pio_command(c, CMD_READ_SECTOR_RETRY);
-	sema_down(&c->completion_wait);
-	if (!wait_while_busy(d))
-		PANIC("%s: disk read failed, sector=%" PRDSNu, d->name, sec_no);
-	input_sector(c, buffer);
-	d->read_cnt++;
-	lock_release(&c->lock);
+	disk_read_multi(d, sec_no, buffer, 1);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -243,21 +371,465 @@ void disk_read(struct disk *d, disk_sector_t sec_no, void *buffer)
    per-disk locking is unneeded. */
 void disk_write(struct disk *d, disk_sector_t sec_no, const void *buffer)
 {
-	struct channel *c;
+	disk_write_multi(d, sec_no, buffer, 1);
+}
+
+/* Reads CNT sectors starting at SEC_NO from disk D into BUFFER,
+   which must have room for CNT * DISK_SECTOR_SIZE bytes, and
+   waits for them.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void disk_read_multi(struct disk *d, disk_sector_t sec_no, void *buffer, size_t cnt)
+{
+	disk_transfer(d, sec_no, buffer, cnt, false);
+}
+
+/* Writes CNT sectors starting at SEC_NO to disk D from BUFFER,
+   which must contain CNT * DISK_SECTOR_SIZE bytes, and waits
+   until the disk has acknowledged receiving them.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void disk_write_multi(struct disk *d, disk_sector_t sec_no, const void *buffer, size_t cnt)
+{
+	disk_transfer(d, sec_no, (void *)buffer, cnt, true);
+}
 
+/* Moves CNT sectors between disk D, starting at SEC_NO, and
+   BUFFER, in the direction given by WRITE.  Keeps a few requests
+   in flight at once so that the channel can merge them. */
+static void
+disk_transfer(struct disk *d, disk_sector_t sec_no, void *buffer, size_t cnt, bool write)
+{
+	struct disk_request reqs[4];
+	uint8_t *p = buffer;
+
+	while (cnt > 0)
+	{
+		size_t n;
+
+		for (n = 0; n < sizeof reqs / sizeof *reqs && cnt > 0; n++)
+		{
+			size_t xfer = cnt < DISK_REQUEST_MAX ? cnt : DISK_REQUEST_MAX;
+
+			disk_request_init(&reqs[n], d, sec_no, p, xfer, write);
+			sec_no += xfer;
+			p += xfer * DISK_SECTOR_SIZE;
+			cnt -= xfer;
+		}
+		disk_submit_batch(reqs, n);
+		for (size_t i = 0; i < n; i++)
+			disk_wait(&reqs[i]);
+	}
+}
+
+/* Asynchronous requests.
+
+   Each channel keeps a queue of submitted requests and has its own
+   dispatcher thread, so the two channels (the file system disk on
+   one, swap on the other) work independently of each other.
+   Whenever the channel goes idle, disk_submit() or the interrupt
+   handler that finishes a command wakes the dispatcher, which
+   picks the next request in C-LOOK elevator order, unless the oldest one is past its
+   deadline, and appends every queued request that continues it on
+   the same disk in the same direction.  The batch goes out as a
+   single command: bus-master DMA with one PRD entry per page
+   piece, or PIO driven block by block from the interrupt handler.
+   The whole queue is guarded by disabling interrupts; the
+   controller itself is programmed with interrupts on, which is
+   safe because it raises no interrupt until the command is under
+   way and only the dispatcher starts commands. */
+
+/* Initializes R to move CNT sectors, at most DISK_REQUEST_MAX,
+   between disk D starting at SEC_NO and BUFFER.  R->complete may
+   be set afterward.  BUFFER must be kernel memory: PIO blocks move
+   in the interrupt handler, under whatever page table is active
+   then. */
+void disk_request_init(struct disk_request *r, struct disk *d, disk_sector_t sec_no,
+					   void *buffer, size_t cnt, bool write)
+{
 	ASSERT(d != NULL);
 	ASSERT(buffer != NULL);
+	ASSERT(is_kernel_vaddr(buffer));
+	ASSERT(cnt > 0 && cnt <= DISK_REQUEST_MAX);
+	ASSERT(sec_no + cnt <= d->capacity);
+
+	r->disk = d;
+	r->sector = sec_no;
+	r->cnt = cnt;
+	r->buffer = buffer;
+	r->write = write;
+	r->complete = NULL;
+	r->aux = NULL;
+	sema_init(&r->done, 0);
+}
 
-	c = d->channel;
-	lock_acquire(&c->lock);
-	select_sector(d, sec_no);
-	issue_pio_command(c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy(d))
-		PANIC("%s: disk write failed, sector=%" PRDSNu, d->name, sec_no);
-	output_sector(c, buffer);
-	sema_down(&c->completion_wait);
-	d->write_cnt++;
-	lock_release(&c->lock);
+/* Queues R and returns at once.  When R finishes, R->complete is
+   called from the interrupt handler, if set, and disk_wait(R)
+   returns.  BUFFER must stay valid until then. */
+void disk_submit(struct disk_request *r)
+{
+	disk_submit_batch(r, 1);
+}
+
+/* Queues the CNT requests in RS, all for disks on one channel, as
+   disk_submit() does, but wakes the dispatcher only after all of
+   them are queued, so that adjacent ones go out merged. */
+void disk_submit_batch(struct disk_request *rs, size_t cnt)
+{
+	struct channel *c = rs[0].disk->channel;
+	int64_t deadline = timer_ticks() + DISK_DEADLINE;
+	enum intr_level old_level;
+
+	old_level = intr_disable();
+	for (size_t i = 0; i < cnt; i++)
+	{
+		ASSERT(rs[i].disk->channel == c);
+		rs[i].deadline = deadline;
+		list_push_back(&c->queue, &rs[i].elem);
+	}
+	if (list_empty(&c->active)) // 진행 중이면 끝날 때 깨움
+		sema_up(&c->dispatch_wait);
+	intr_set_level(old_level);
+}
+
+/* Waits for R, which must have been submitted, to finish. */
+void disk_wait(struct disk_request *r)
+{
+	sema_down(&r->done);
+}
+
+/* Returns the number of pages R's buffer touches, which is the
+   number of PRD entries it takes. */
+static size_t
+request_pages(const struct disk_request *r)
+{
+	return DIV_ROUND_UP(pg_ofs(r->buffer) + r->cnt * DISK_SECTOR_SIZE, PGSIZE);
+}
+
+/* Returns true if the controller can reach R's buffer by DMA: it
+   lies below 4 GB. */
+static bool
+request_dma_ok(const struct disk_request *r)
+{
+	return vtop(r->buffer) + r->cnt * DISK_SECTOR_SIZE <= 0x100000000ULL;
+}
+
+/* Picks the request to serve next from C's queue. */
+static struct disk_request *
+elevator_pick(struct channel *c)
+{
+	struct disk_request *next = NULL, *lowest = NULL, *oldest = NULL;
+	struct list_elem *e;
+
+	for (e = list_begin(&c->queue); e != list_end(&c->queue); e = list_next(e))
+	{
+		struct disk_request *r = list_entry(e, struct disk_request, elem);
+
+		if (oldest == NULL || r->deadline < oldest->deadline)
+			oldest = r;
+		if (r->sector >= c->head && (next == NULL || r->sector < next->sector))
+			next = r;
+		if (lowest == NULL || r->sector < lowest->sector)
+			lowest = r;
+	}
+	if (oldest->deadline <= timer_ticks())
+		return oldest;
+	return next != NULL ? next : lowest; // 끝까지 갔으면 맨 앞으로
+}
+
+/* Dispatcher thread for channel C_: starts a batch each time it is
+   woken and C is idle. */
+static void
+channel_dispatcher(void *c_)
+{
+	struct channel *c = c_;
+
+	for (;;)
+	{
+		sema_down(&c->dispatch_wait);
+		channel_dispatch(c);
+	}
+}
+
+/* Records that C went BUSY or idle.  Whole ticks are coarse for a
+   single batch, but a batch straddles a tick boundary with
+   probability proportional to its length, so the totals come out
+   right over many batches.  Interrupts must be off. */
+static void
+account_busy(struct channel *c, bool busy)
+{
+	int64_t now = timer_ticks();
+
+	ASSERT(intr_get_level() == INTR_OFF);
+	if (busy)
+	{
+		c->busy_since = now;
+		c->batch_cnt++;
+		if (++busy_channels == CHANNEL_CNT)
+			overlap_since = now;
+	}
+	else
+	{
+		c->busy_ticks += now - c->busy_since;
+		if (busy_channels-- == CHANNEL_CNT)
+			overlap_ticks += now - overlap_since;
+	}
+}
+
+/* Starts the next batch on C if C is idle and has queued requests.
+   Called only from C's dispatcher. */
+static void
+channel_dispatch(struct channel *c)
+{
+	struct disk_request *first;
+	size_t cnt, pages;
+	bool dma, merged;
+	enum intr_level old_level;
+
+	old_level = intr_disable();
+	if (!list_empty(&c->active) || list_empty(&c->queue))
+	{
+		intr_set_level(old_level);
+		return;
+	}
+
+	first = elevator_pick(c);
+	list_remove(&first->elem);
+	list_push_back(&c->active, &first->elem);
+	cnt = first->cnt;
+	pages = request_pages(first);
+	dma = c->bm_base != 0 && first->disk->dma && request_dma_ok(first);
+
+	/* Merge requests that start where the batch ends. */
+	do
+	{
+		struct list_elem *e;
+
+		merged = false;
+		for (e = list_begin(&c->queue); e != list_end(&c->queue); e = list_next(e))
+		{
+			struct disk_request *r = list_entry(e, struct disk_request, elem);
+
+			if (r->disk != first->disk || r->write != first->write
+				|| r->sector != first->sector + cnt || cnt + r->cnt > MAX_BATCH_SECTORS
+				|| (dma && (!request_dma_ok(r) || pages + request_pages(r) > PRD_CNT)))
+				continue;
+			list_remove(&r->elem);
+			list_push_back(&c->active, &r->elem);
+			cnt += r->cnt;
+			pages += request_pages(r);
+			merged = true;
+			break;
+		}
+	} while (merged);
+
+	c->head = first->sector + cnt;
+	c->xfer_disk = first->disk;
+	c->xfer_write = first->write;
+	c->xfer_dma = dma;
+	c->xfer_cnt = cnt;
+	c->xfer_done = 0;
+	c->cursor = list_begin(&c->active);
+	c->cursor_ofs = 0;
+	account_busy(c, true);
+	intr_set_level(old_level);
+
+	if (dma)
+		dma_start(c, first->sector);
+	else
+		pio_start(c, first->sector);
+}
+
+/* Returns the buffer for the next sector of C's PIO batch and
+   moves past it. */
+static uint8_t *
+pio_next_sector(struct channel *c)
+{
+	struct disk_request *r = list_entry(c->cursor, struct disk_request, elem);
+	uint8_t *p = (uint8_t *)r->buffer + c->cursor_ofs * DISK_SECTOR_SIZE;
+
+	if (++c->cursor_ofs == r->cnt)
+	{
+		c->cursor = list_next(c->cursor);
+		c->cursor_ofs = 0;
+	}
+	c->xfer_done++;
+	return p;
+}
+
+/* Moves the next DRQ block of C's PIO batch through the data
+   register. */
+static void
+pio_block(struct channel *c)
+{
+	size_t left = c->xfer_cnt - c->xfer_done;
+	size_t block = left < (size_t)c->xfer_disk->multiple ? left : (size_t)c->xfer_disk->multiple;
+
+	for (size_t i = 0; i < block; i++)
+		if (c->xfer_write)
+			output_sector(c, pio_next_sector(c));
+		else
+			input_sector(c, pio_next_sector(c));
+}
+
+/* Issues C's batch starting at SEC_NO as a PIO command.  A write
+   sends its first block right away; the rest moves block by block
+   in the interrupt handler. */
+static void
+pio_start(struct channel *c, disk_sector_t sec_no)
+{
+	struct disk *d = c->xfer_disk;
+	uint8_t cmd;
+
+	if (c->xfer_write)
+		cmd = d->multiple > 1 ? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY;
+	else
+		cmd = d->multiple > 1 ? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY;
+	select_sector(d, sec_no, c->xfer_cnt);
+	issue_command(c, cmd);
+	if (c->xfer_write)
+	{
+		if (!wait_for_drq(d))
+			PANIC("%s: disk write failed, sector=%" PRDSNu, d->name, sec_no);
+		pio_block(c);
+	}
+}
+
+/* Issues C's batch starting at SEC_NO as a bus-master DMA
+   command, with one PRD entry per page piece of each buffer,
+   since only the bytes within a page are known to be physically
+   contiguous. */
+static void
+dma_start(struct channel *c, disk_sector_t sec_no)
+{
+	struct list_elem *e;
+	size_t n = 0;
+
+	for (e = list_begin(&c->active); e != list_end(&c->active); e = list_next(e))
+	{
+		struct disk_request *r = list_entry(e, struct disk_request, elem);
+		uint8_t *p = r->buffer;
+		size_t left = r->cnt * DISK_SECTOR_SIZE;
+
+		while (left > 0)
+		{
+			size_t chunk = PGSIZE - pg_ofs(p);
+
+			if (chunk > left)
+				chunk = left;
+			ASSERT(n < PRD_CNT);
+			c->prd[n].addr = vtop(p);
+			c->prd[n].size = chunk;
+			c->prd[n].flags = 0;
+			n++;
+			p += chunk;
+			left -= chunk;
+		}
+	}
+	c->prd[n - 1].flags = PRD_EOT;
+
+	outl(bm_prdt(c), vtop(c->prd));
+	outb(bm_command(c), c->xfer_write ? 0 : BM_CMD_READ);
+	outb(bm_status(c), inb(bm_status(c)) | BM_STA_IRQ | BM_STA_ERR); /* Write 1 to clear. */
+	select_sector(c->xfer_disk, sec_no, c->xfer_cnt);
+	issue_command(c, c->xfer_write ? CMD_WRITE_DMA : CMD_READ_DMA);
+	outb(bm_command(c), inb(bm_command(c)) | BM_CMD_START);
+}
+
+/* Handles an interrupt for C's batch in progress: moves the next
+   PIO block, or finishes the batch and wakes the dispatcher for the
+   next one. */
+static void
+channel_interrupt(struct channel *c)
+{
+	struct disk *d = c->xfer_disk;
+	uint8_t status = inb(reg_status(c)); /* Acknowledge interrupt. */
+
+	if (c->xfer_dma)
+	{
+		uint8_t bm = inb(bm_status(c));
+
+		outb(bm_command(c), inb(bm_command(c)) & ~BM_CMD_START);
+		outb(bm_status(c), bm | BM_STA_IRQ | BM_STA_ERR);
+		if ((bm & BM_STA_ERR) || (status & STA_ERR))
+			PANIC("%s: disk DMA %s failed", d->name, c->xfer_write ? "write" : "read");
+	}
+	else if (!c->xfer_write)
+	{
+		if ((status & STA_ERR) || !(status & STA_DRQ))
+			PANIC("%s: disk read failed", d->name);
+		pio_block(c);
+		if (c->xfer_done < c->xfer_cnt)
+			return;
+	}
+	else if (c->xfer_done < c->xfer_cnt)
+	{
+		if (!wait_for_drq(d))
+			PANIC("%s: disk write failed", d->name);
+		pio_block(c);
+		return;
+	}
+
+	/* The batch is done. */
+	while (!list_empty(&c->active))
+	{
+		struct disk_request *r = list_entry(list_pop_front(&c->active),
+											struct disk_request, elem);
+		if (r->write)
+			d->write_cnt += r->cnt;
+		else
+			d->read_cnt += r->cnt;
+		if (r->complete != NULL)
+			r->complete(r);
+		sema_up(&r->done);
+	}
+	account_busy(c, false);
+	sema_up(&c->dispatch_wait);
+}
+
+/* Finds the PCI IDE controller and returns the I/O base of its
+   bus-master registers, with bus mastering enabled, or 0 if there
+   is none.  Only bus 0 is scanned, which is where QEMU and Bochs
+   put their PIIX. */
+static uint16_t
+find_bus_master(void)
+{
+	for (int dev = 0; dev < 32; dev++)
+		for (int func = 0; func < 8; func++)
+		{
+			uint32_t class, bar4;
+
+			if ((pci_read(dev, func, PCI_ID) & 0xffff) == 0xffff)
+				continue;
+			class = pci_read(dev, func, PCI_CLASS);
+			if (class >> 16 != PCI_CLASS_IDE || !(class & PCI_PROGIF_BUS_MASTER))
+				continue;
+			bar4 = pci_read(dev, func, PCI_BAR4);
+			if (!(bar4 & 1)) /* Not an I/O port BAR. */
+				continue;
+			pci_write(dev, func, PCI_COMMAND,
+					  pci_read(dev, func, PCI_COMMAND) | PCI_CMD_IO | PCI_CMD_BUS_MASTER);
+			return bar4 & ~3;
+		}
+	return 0;
+}
+
+/* Reads the 32-bit PCI configuration register REG of device DEV,
+   function FUNC on bus 0. */
+static uint32_t
+pci_read(int dev, int func, uint8_t reg)
+{
+	outl(PCI_CONFIG_ADDRESS, 0x80000000 | dev << 11 | func << 8 | (reg & 0xfc));
+	return inl(PCI_CONFIG_DATA);
+}
+
+/* Writes VALUE to PCI configuration register REG of device DEV,
+   function FUNC on bus 0. */
+static void
+pci_write(int dev, int func, uint8_t reg, uint32_t value)
+{
+	outl(PCI_CONFIG_ADDRESS, 0x80000000 | dev << 11 | func << 8 | (reg & 0xfc));
+	outl(PCI_CONFIG_DATA, value);
 }
 
 /* Disk detection and identification. */
@@ -382,6 +954,13 @@ identify_ata_device(struct disk *d)
 	/* Calculate capacity. */
 	d->capacity = id[60] | ((uint32_t)id[61] << 16);
 
+	/* Word 47 gives the largest DRQ block READ/WRITE MULTIPLE
+	   support, 0 if they are not supported. */
+	set_multiple_mode(d, id[47] & 0xff);
+
+	/* Word 49 bit 8 says whether the disk can do DMA. */
+	d->dma = (id[49] & 0x0100) != 0;
+
 	/* Print identification message. */
 	printf("%s: detected %'" PRDSNu " sector (", d->name, d->capacity);
 	if (d->capacity > 1024 / DISK_SECTOR_SIZE * 1024 * 1024)
@@ -400,6 +979,29 @@ identify_ata_device(struct disk *d)
 	printf("\"\n");
 }
 
+/* Enables READ/WRITE MULTIPLE on disk D with the largest power of
+   two DRQ block up to both MAX and MAX_MULTIPLE sectors.  Leaves
+   D->multiple at 1 if MAX is below 2 or the disk refuses. */
+static void
+set_multiple_mode(struct disk *d, int max)
+{
+	struct channel *c = d->channel;
+	int block = 1;
+
+	while (block * 2 <= max && block * 2 <= MAX_MULTIPLE)
+		block *= 2;
+	if (block == 1)
+		return;
+
+	select_device_wait(d);
+	outb(reg_nsect(c), block);
+	issue_pio_command(c, CMD_SET_MULTIPLE_MODE);
+	sema_down(&c->completion_wait);
+	wait_while_busy(d);
+	if (!(inb(reg_alt_status(c)) & STA_ERR))
+		d->multiple = block;
+}
+
 /* Prints STRING, which consists of SIZE bytes in a funky format:
    each pair of bytes is in reverse order.  Does not print
    trailing whitespace and/or nulls. */
@@ -422,17 +1024,18 @@ print_ata_string(char *string, size_t size)
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the count CNT to the disk's sector selection
+   registers.  (We use LBA mode.) */
 static void
-select_sector(struct disk *d, disk_sector_t sec_no)
+select_sector(struct disk *d, disk_sector_t sec_no, size_t cnt)
 {
 	struct channel *c = d->channel;
-	ASSERT(sec_no < d->capacity);
-	ASSERT(sec_no < (1UL << 28));
+	ASSERT(cnt > 0 && cnt <= MAX_XFER_SECTORS);
+	ASSERT(sec_no + cnt <= d->capacity);
+	ASSERT(sec_no + cnt <= (1UL << 28));
 
 	select_device_wait(d);
-	outb(reg_nsect(c), 1);
+	outb(reg_nsect(c), cnt == MAX_XFER_SECTORS ? 0 : cnt);
 	outb(reg_lbal(c), sec_no);
 	outb(reg_lbam(c), sec_no >> 8);
 	outb(reg_lbah(c), (sec_no >> 16));
@@ -453,6 +1056,15 @@ issue_pio_command(struct channel *c, uint8_t command)
 	outb(reg_command(c), command);
 }
 
+/* Writes COMMAND to channel C from the request dispatcher, which
+   may run in the interrupt handler. */
+static void
+issue_command(struct channel *c, uint8_t command)
+{
+	c->expecting_interrupt = true;
+	outb(reg_command(c), command);
+}
+
 /* Reads a sector from channel C's data register in PIO mode into
    SECTOR, which must have room for DISK_SECTOR_SIZE bytes. */
 static void
@@ -485,7 +1097,7 @@ wait_until_idle(const struct disk *d)
 	{
 		if ((inb(reg_status(d->channel)) & (STA_BSY | STA_DRQ)) == 0)
 			return;
-		timer_usleep(10);
+		timer_udelay(10);
 	}
 
 	printf("%s: idle timeout\n", d->name);
@@ -518,6 +1130,24 @@ wait_while_busy(const struct disk *d)
 	return false;
 }
 
+/* Waits up to 10 ms, without sleeping, for disk D to clear BSY,
+   and returns the status of the DRQ bit.  Used where the
+   interrupt handler moves a PIO write block. */
+static bool
+wait_for_drq(const struct disk *d)
+{
+	struct channel *c = d->channel;
+
+	for (int i = 0; i < 1000; i++)
+	{
+		uint8_t status = inb(reg_alt_status(c));
+		if (!(status & STA_BSY))
+			return (status & STA_DRQ) != 0;
+		timer_udelay(10);
+	}
+	return false;
+}
+
 /* Program D's channel so that D is now the selected disk. */
 static void
 select_device(const struct disk *d)
@@ -528,7 +1158,7 @@ select_device(const struct disk *d)
 		dev |= DEV_DEV;
 	outb(reg_device(c), dev);
 	inb(reg_alt_status(c));
-	timer_nsleep(400);
+	timer_ndelay(400);
 }
 
 /* Select disk D in its channel, as select_device(), but wait for
@@ -550,7 +1180,9 @@ interrupt_handler(struct intr_frame *f)
 	for (c = channels; c < channels + CHANNEL_CNT; c++)
 		if (f->vec_no == c->irq)
 		{
-			if (c->expecting_interrupt)
+			if (!list_empty(&c->active))
+				channel_interrupt(c);
+			else if (c->expecting_interrupt)
 			{
 				inb(reg_status(c));			  /* Acknowledge interrupt. */
 				sema_up(&c->completion_wait); /* Wake up waiter. */
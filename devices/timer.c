@@ -7,6 +7,7 @@
 #include "threads/io.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -20,6 +21,9 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* TSC cycles spent in timer_interrupt() since boot. */
+static uint64_t handler_cycles;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -28,6 +32,7 @@ static intr_handler_func timer_interrupt;
 static bool too_many_loops(unsigned loops);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
+static void real_time_delay(int64_t num, int32_t denom);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
@@ -119,6 +124,31 @@ void timer_nsleep(int64_t ns)
 	real_time_sleep(ns, 1000 * 1000 * 1000);
 }
 
+/* Busy-waits for approximately US microseconds.  Interrupts need
+   not be turned on, so this may be used in interrupt handlers. */
+void timer_udelay(int64_t us)
+{
+	real_time_delay(us, 1000 * 1000);
+}
+
+/* Busy-waits for approximately NS nanoseconds.  Interrupts need
+   not be turned on, so this may be used in interrupt handlers. */
+void timer_ndelay(int64_t ns)
+{
+	real_time_delay(ns, 1000 * 1000 * 1000);
+}
+
+/* Returns the number of TSC cycles spent in the timer interrupt
+   handler since the OS booted. */
+uint64_t
+timer_handler_cycles(void)
+{
+	enum intr_level old_level = intr_disable();
+	uint64_t c = handler_cycles;
+	intr_set_level(old_level);
+	return c;
+}
+
 /* Prints timer statistics. */
 void timer_print_stats(void)
 {
@@ -129,9 +159,12 @@ void timer_print_stats(void)
 static void
 timer_interrupt(struct intr_frame *args UNUSED)
 {
+	uint64_t start = rdtsc();
+
 	ticks++;
 	thread_tick();
 	thread_wakeup(ticks);
+	handler_cycles += rdtsc() - start;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -167,6 +200,16 @@ busy_wait(int64_t loops)
 		barrier();
 }
 
+/* Busy-wait for approximately NUM/DENOM seconds. */
+static void
+real_time_delay(int64_t num, int32_t denom)
+{
+	/* Scale the numerator and denominator down by 1000 to avoid
+	   the possibility of overflow. */
+	ASSERT(denom % 1000 == 0);
+	busy_wait(loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
+}
+
 /* Sleep for approximately NUM/DENOM seconds. */
 static void
 real_time_sleep(int64_t num, int32_t denom)
@@ -0,0 +1,177 @@
+/* dcache.c: Dentry cache for path resolution. */
+
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Most entries the cache holds before it reuses the least
+ * recently used one. */
+#define DCACHE_SIZE 256
+
+/* One cached name.  A negative entry records that NAME is absent
+ * from PARENT, so that failing lookups are cached too. */
+struct dentry
+{
+	disk_sector_t parent;	 /* Sector of the directory's inode. */
+	char name[NAME_MAX + 1]; /* Name within PARENT. */
+	bool negative;			 /* True if NAME does not exist. */
+	disk_sector_t sector;	 /* Inode sector of NAME, if it exists. */
+	struct hash_elem h_elem; /* Element in dentries. */
+	struct list_elem l_elem; /* Element in lru, most recent first. */
+};
+
+/* Guards everything below. */
+static struct lock dcache_lock;
+static struct hash dentries;
+static struct list lru;
+static size_t dentry_cnt;
+
+static uint64_t
+dentry_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	const struct dentry *d = hash_entry(e, struct dentry, h_elem);
+	return hash_bytes(&d->parent, sizeof d->parent) ^ hash_string(d->name);
+}
+
+static bool
+dentry_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED)
+{
+	const struct dentry *a = hash_entry(a_, struct dentry, h_elem);
+	const struct dentry *b = hash_entry(b_, struct dentry, h_elem);
+
+	if (a->parent != b->parent)
+		return a->parent < b->parent;
+	return strcmp(a->name, b->name) < 0;
+}
+
+/* Returns the entry for (PARENT, NAME), or NULL.
+ * dcache_lock must be held. */
+static struct dentry *
+dentry_find(disk_sector_t parent, const char *name)
+{
+	struct dentry key;
+	struct hash_elem *e;
+
+	key.parent = parent;
+	strlcpy(key.name, name, sizeof key.name);
+	e = hash_find(&dentries, &key.h_elem);
+	return e != NULL ? hash_entry(e, struct dentry, h_elem) : NULL;
+}
+
+/* Drops D from the cache.  dcache_lock must be held. */
+static void
+dentry_free(struct dentry *d)
+{
+	hash_delete(&dentries, &d->h_elem);
+	list_remove(&d->l_elem);
+	dentry_cnt--;
+	free(d);
+}
+
+void dcache_init(void)
+{
+	lock_init(&dcache_lock);
+	hash_init(&dentries, dentry_hash, dentry_less, NULL);
+	list_init(&lru);
+	dentry_cnt = 0;
+}
+
+/* Looks up NAME in the directory whose inode is at PARENT.  On a
+ * hit, stores the inode sector of NAME in *SECTOR. */
+enum dcache_result
+dcache_lookup(disk_sector_t parent, const char *name, disk_sector_t *sector)
+{
+	enum dcache_result result = DCACHE_MISS;
+	struct dentry *d;
+
+	if (strlen(name) > NAME_MAX)
+		return DCACHE_MISS;
+	lock_acquire(&dcache_lock);
+	d = dentry_find(parent, name);
+	if (d != NULL)
+	{
+		list_remove(&d->l_elem);
+		list_push_front(&lru, &d->l_elem);
+		if (d->negative)
+			result = DCACHE_NEGATIVE;
+		else
+		{
+			*sector = d->sector;
+			result = DCACHE_HIT;
+		}
+	}
+	lock_release(&dcache_lock);
+	return result;
+}
+
+/* Records that NAME in PARENT is the inode at SECTOR, or that it
+ * does not exist if EXISTS is false.  The caller must hold
+ * PARENT's directory lock, so that the answer is not stale. */
+void dcache_insert(disk_sector_t parent, const char *name, bool exists,
+				   disk_sector_t sector)
+{
+	struct dentry *d;
+
+	if (strlen(name) > NAME_MAX)
+		return;
+	lock_acquire(&dcache_lock);
+	d = dentry_find(parent, name);
+	if (d == NULL)
+	{
+		if (dentry_cnt >= DCACHE_SIZE)
+			dentry_free(list_entry(list_back(&lru), struct dentry, l_elem));
+		d = malloc(sizeof *d);
+		if (d == NULL)
+		{
+			lock_release(&dcache_lock);
+			return;
+		}
+		d->parent = parent;
+		strlcpy(d->name, name, sizeof d->name);
+		hash_insert(&dentries, &d->h_elem);
+		dentry_cnt++;
+	}
+	else
+		list_remove(&d->l_elem);
+	list_push_front(&lru, &d->l_elem);
+	d->negative = !exists;
+	d->sector = sector;
+	lock_release(&dcache_lock);
+}
+
+/* Forgets NAME in PARENT.  Called whenever the entry changes. */
+void dcache_invalidate(disk_sector_t parent, const char *name)
+{
+	struct dentry *d;
+
+	if (strlen(name) > NAME_MAX)
+		return;
+	lock_acquire(&dcache_lock);
+	d = dentry_find(parent, name);
+	if (d != NULL)
+		dentry_free(d);
+	lock_release(&dcache_lock);
+}
+
+/* Forgets every name in directory PARENT, whose inode is going
+ * away and whose sector may be reused. */
+void dcache_purge_dir(disk_sector_t parent)
+{
+	struct list_elem *e;
+
+	lock_acquire(&dcache_lock);
+	for (e = list_begin(&lru); e != list_end(&lru);)
+	{
+		struct dentry *d = list_entry(e, struct dentry, l_elem);
+
+		e = list_next(e);
+		if (d->parent == parent)
+			dentry_free(d);
+	}
+	lock_release(&dcache_lock);
+}
@@ -2,10 +2,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include <hash.h>
+#include <round.h>
 #include "threads/thread.h"
 #include "filesys/filesys.h"
+#include "filesys/dcache.h"
 #include "filesys/inode.h"
 #include "filesys/fat.h"
+#include "filesys/page_cache.h"
 #include "threads/malloc.h"
 
 /* A directory. */
@@ -13,6 +17,7 @@ struct dir
 {
 	struct inode *inode; /* Backing store. */
 	off_t pos;			 /* Current position. */
+	bool hashed;		 /* Hashed layout? Otherwise linear. */
 };
 
 /* A single directory entry. */
@@ -23,13 +28,82 @@ struct dir_entry
 	bool in_use;				/* In use or free? */
 };
 
+/* Hashed directories.
+ *
+ * A linear directory is a flat array of dir_entry.  A hashed
+ * directory is an array of DIR_BLOCK_SIZE blocks instead: block 0
+ * is a dir_header whose table maps each hash bucket to a chain of
+ * dir_leaf blocks holding the entries of names that hash there.
+ * The header starts out like a free dir_entry, and a linear
+ * directory always has "." in use in its first slot, so the two
+ * are told apart by the first entry alone. */
+#define DIR_BLOCK_SIZE DISK_SECTOR_SIZE
+#define DIR_HASH_MAGIC 0x48524944 /* "DIRH" */
+#define DIR_BUCKET_CNT 120
+#define DIR_LEAF_ENTRIES 25
+
+/* Block 0 of a hashed directory. */
+struct dir_header
+{
+	uint32_t magic;					 /* DIR_HASH_MAGIC, where inode_sector is. */
+	char name[NAME_MAX + 1];		 /* Empty. */
+	bool in_use;					 /* Always false. */
+	uint32_t buckets[DIR_BUCKET_CNT]; /* First leaf block of each bucket, 0 if none. */
+	uint32_t unused[3];
+};
+
+/* A leaf block of a hashed directory. */
+struct dir_leaf
+{
+	uint32_t next; /* Next leaf block in the bucket, 0 if none. */
+	uint32_t used; /* Number of entries in use. */
+	uint32_t unused;
+	struct dir_entry entries[DIR_LEAF_ENTRIES];
+};
+
+/* Returns the byte offset of entry IDX of leaf block BLOCK. */
+static inline off_t
+leaf_entry_ofs(uint32_t block, size_t idx)
+{
+	return block * DIR_BLOCK_SIZE + offsetof(struct dir_leaf, entries) + idx * sizeof(struct dir_entry);
+}
+
+/* Returns the bucket NAME hashes to. */
+static inline size_t
+dir_bucket(const char *name)
+{
+	return hash_string(name) % DIR_BUCKET_CNT;
+}
+
+/* Returns the free-slot hints of hashed directory DIR, or a null
+ * pointer if memory is short.  Entry B is the byte offset of a free
+ * slot in a leaf of bucket B, or 0 if none is known.  They live with
+ * the inode and are kept up to date by hashed_put() and
+ * hashed_add_leaf(), all under the directory lock. */
+static uint32_t *
+dir_hints(struct dir *dir)
+{
+	return inode_dir_hints(dir->inode, DIR_BUCKET_CNT);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
  * given SECTOR.  Returns true if successful, false on failure. */
-bool dir_create(disk_sector_t sector, size_t entry_cnt, const char *dir)
+bool dir_create(disk_sector_t sector, size_t entry_cnt UNUSED, const char *dir)
 {
+	struct dir_header hdr = {.magic = DIR_HASH_MAGIC};
+	struct inode *inode;
+
+	ASSERT(sizeof hdr == DIR_BLOCK_SIZE);
+	ASSERT(sizeof(struct dir_leaf) == DIR_BLOCK_SIZE);
+
 	dir_add(thread_current()->dir, dir, sector);
-	bool success = inode_create(sector, entry_cnt * sizeof(struct dir_entry), 1);
-	struct dir *new_dir = dir_open(inode_open(sector));
+	bool success = inode_create(sector, sizeof hdr, 1);
+
+	// 새 디렉터리는 hash 형식으로 만듦
+	inode = inode_open(sector);
+	if (inode != NULL)
+		inode_write_at(inode, &hdr, sizeof hdr, 0);
+	struct dir *new_dir = dir_open(inode);
 	dir_add(new_dir, ".", sector);
 	dir_add(new_dir, "..", inode_get_inumber(dir_get_inode(thread_current()->dir)));
 	return success;
@@ -43,8 +117,11 @@ dir_open(struct inode *inode)
 	struct dir *dir = calloc(1, sizeof *dir);
 	if (inode != NULL && dir != NULL)
 	{
+		struct dir_entry e;
+
 		dir->inode = inode;
 		dir->pos = 0;
+		dir->hashed = inode_read_at(inode, &e, sizeof e, 0) == sizeof e && !e.in_use && e.inode_sector == DIR_HASH_MAGIC;
 		return dir;
 	}
 	else
@@ -88,27 +165,88 @@ dir_get_inode(struct dir *dir)
 	return dir->inode;
 }
 
+/* Formats ROOT, the root directory of a new file system, in the
+ * hashed layout and makes it the current thread's directory.  The
+ * root cluster is not zeroed by fat_create(), so the whole header
+ * is written.  Roots formatted before are linear and still open as
+ * such in dir_open(). */
 void init_root_dir(struct dir *root)
 {
-	uint8_t *buf = calloc(1, DISK_SECTOR_SIZE);
-	struct dir_entry tmp;
-	disk_read(filesys_disk, cluster_to_sector(ROOT_DIR_CLUSTER), buf);
-	memcpy(&tmp, buf, sizeof(struct dir_entry));
-	if (strcmp(tmp.name, "."))
+	struct dir_header hdr = {.magic = DIR_HASH_MAGIC};
+
+	if (inode_write_at(root->inode, &hdr, sizeof hdr, 0) == sizeof hdr)
+		root->hashed = true;
+	dir_add(root, ".", ROOT_DIR_SECTOR);
+	dir_add(root, "..", ROOT_DIR_SECTOR);
+	thread_current()->dir = root;
+}
+
+/* Hashed counterpart of lookup(): searches only the leaves of
+ * NAME's bucket.  A free slot is a slot in one of those leaves, or
+ * -1 if all of them are full. */
+static bool
+hashed_lookup(const struct dir *dir, const char *name,
+			  struct dir_entry *ep, off_t *ofsp, off_t *freep)
+{
+	struct dir_leaf *leaf = malloc(sizeof *leaf);
+	uint32_t block;
+	bool found = false;
+
+	if (freep != NULL)
+		*freep = -1;
+	if (leaf == NULL)
+		return false;
+	if (inode_read_at(dir->inode, &block, sizeof block,
+					  offsetof(struct dir_header, buckets) + dir_bucket(name) * sizeof block) != sizeof block)
+		block = 0;
+	for (; block != 0 && !found; block = leaf->next)
 	{
-		dir_add(root, ".", ROOT_DIR_SECTOR);
-		dir_add(root, "..", ROOT_DIR_SECTOR);
+		if (inode_read_at(dir->inode, leaf, sizeof *leaf, block * DIR_BLOCK_SIZE) != sizeof *leaf)
+			break;
+		/* Once USED entries in use have been seen, the rest of the
+		 * leaf is free and only worth scanning for a free slot. */
+		uint32_t seen = 0;
+		for (size_t i = 0; i < DIR_LEAF_ENTRIES
+						   && (seen < leaf->used || (freep != NULL && *freep == -1));
+			 i++)
+		{
+			struct dir_entry *e = &leaf->entries[i];
+
+			if (!e->in_use)
+			{
+				if (freep != NULL && *freep == -1)
+					*freep = leaf_entry_ofs(block, i);
+			}
+			else
+			{
+				seen++;
+				if (!strcmp(name, e->name))
+				{
+					if (ep != NULL)
+						*ep = *e;
+					if (ofsp != NULL)
+						*ofsp = leaf_entry_ofs(block, i);
+					found = true;
+					break;
+				}
+			}
+		}
 	}
-	thread_current()->dir = root;
+	free(leaf);
+	return found;
 }
+
 /* Searches DIR for a file with the given NAME.
  * If successful, returns true, sets *EP to the directory entry
  * if EP is non-null, and sets *OFSP to the byte offset of the
  * directory entry if OFSP is non-null.
- * otherwise, returns false and ignores EP and OFSP. */
+ * otherwise, returns false and ignores EP and OFSP.
+ * If FREEP is non-null, the same pass sets *FREEP to the offset of
+ * a slot a new entry may go into (see hashed_lookup() for hashed
+ * directories; the end of file for a full linear one). */
 static bool
 lookup(const struct dir *dir, const char *name,
-	   struct dir_entry *ep, off_t *ofsp)
+	   struct dir_entry *ep, off_t *ofsp, off_t *freep)
 {
 	struct dir_entry e;
 	size_t ofs;
@@ -116,9 +254,19 @@ lookup(const struct dir *dir, const char *name,
 	ASSERT(dir != NULL);
 	ASSERT(name != NULL);
 
+	if (dir->hashed)
+		return hashed_lookup(dir, name, ep, ofsp, freep);
+
+	if (freep != NULL)
+		*freep = -1;
 	for (ofs = 0; inode_read_at(dir->inode, &e, sizeof e, ofs) == sizeof e;
 		 ofs += sizeof e)
-		if (e.in_use && !strcmp(name, e.name))
+		if (!e.in_use)
+		{
+			if (freep != NULL && *freep == -1)
+				*freep = ofs;
+		}
+		else if (!strcmp(name, e.name))
 		{
 			if (ep != NULL)
 				*ep = e;
@@ -126,26 +274,118 @@ lookup(const struct dir *dir, const char *name,
 				*ofsp = ofs;
 			return true;
 		}
+	if (freep != NULL && *freep == -1)
+		*freep = ofs;
 	return false;
 }
 
+/* Stores E at byte offset OFS in a leaf of hashed directory DIR
+ * and adjusts the leaf's count of used entries by DELTA.  Returns
+ * true if successful.  Afterward the hint for E's bucket points at
+ * a free slot of this leaf, if it has one. */
+static bool
+hashed_put(struct dir *dir, const struct dir_entry *e, off_t ofs, int delta)
+{
+	struct dir_leaf *leaf = malloc(sizeof *leaf);
+	off_t block_ofs = ofs - ofs % DIR_BLOCK_SIZE;
+	uint32_t *hints = dir_hints(dir);
+	bool success = false;
+
+	if (leaf == NULL)
+		return false;
+	if (inode_read_at(dir->inode, leaf, sizeof *leaf, block_ofs) == sizeof *leaf)
+	{
+		leaf->entries[(ofs - leaf_entry_ofs(0, 0) - block_ofs) / sizeof *e] = *e;
+		leaf->used += delta;
+		success = inode_write_at(dir->inode, leaf, sizeof *leaf, block_ofs) == sizeof *leaf;
+	}
+	if (success && hints != NULL)
+	{
+		uint32_t *hint = &hints[dir_bucket(e->name)];
+
+		if (!e->in_use)
+			*hint = ofs;
+		else if (*hint == 0 || *hint == (uint32_t)ofs)
+		{
+			// 같은 leaf의 다음 빈 칸, 없으면 모름
+			*hint = 0;
+			for (size_t i = 0; i < DIR_LEAF_ENTRIES && leaf->used < DIR_LEAF_ENTRIES; i++)
+				if (!leaf->entries[i].in_use)
+				{
+					*hint = leaf_entry_ofs(block_ofs / DIR_BLOCK_SIZE, i);
+					break;
+				}
+		}
+	}
+	free(leaf);
+	return success;
+}
+
+/* Adds E to hashed directory DIR in a new leaf at the end of the
+ * file, pushed onto the front of its bucket.  The leaf is written
+ * before the bucket points at it, and its second slot becomes the
+ * bucket's hint. */
+static bool
+hashed_add_leaf(struct dir *dir, const struct dir_entry *e)
+{
+	off_t bucket_ofs = offsetof(struct dir_header, buckets) + dir_bucket(e->name) * sizeof(uint32_t);
+	uint32_t block = DIV_ROUND_UP(inode_length(dir->inode), DIR_BLOCK_SIZE);
+	struct dir_leaf *leaf = calloc(1, sizeof *leaf);
+	uint32_t *hints = dir_hints(dir);
+	bool success = false;
+
+	if (leaf == NULL)
+		return false;
+	if (inode_read_at(dir->inode, &leaf->next, sizeof leaf->next, bucket_ofs) == sizeof leaf->next)
+	{
+		leaf->used = 1;
+		leaf->entries[0] = *e;
+		success = inode_write_at(dir->inode, leaf, sizeof *leaf, block * DIR_BLOCK_SIZE) == sizeof *leaf && inode_write_at(dir->inode, &block, sizeof block, bucket_ofs) == sizeof block;
+	}
+	if (success && hints != NULL)
+		hints[dir_bucket(e->name)] = leaf_entry_ofs(block, 1);
+	free(leaf);
+	return success;
+}
+
 /* Searches DIR for a file with the given NAME
  * and returns true if one exists, false otherwise.
  * On success, sets *INODE to an inode for the file, otherwise to
- * a null pointer.  The caller must close *INODE. */
+ * a null pointer.  The caller must close *INODE.
+ * The answer comes from the dentry cache if it is there; otherwise
+ * the directory is searched.  Both happen with the directory's
+ * lock held shared, and so does the open, so that neither the
+ * result cached nor the inode opened can race with dir_add() or
+ * dir_remove(), which hold it exclusively.  Lookups in the same
+ * directory run side by side; two that miss together cache the
+ * same answer. */
 bool dir_lookup(const struct dir *dir, const char *name,
 				struct inode **inode)
 {
+	disk_sector_t parent = inode_get_inumber(dir->inode);
 	struct dir_entry e;
+	bool found;
 
 	ASSERT(dir != NULL);
 	ASSERT(name != NULL);
 
-	if (lookup(dir, name, &e, NULL))
-		*inode = inode_open(e.inode_sector);
-	else
-		*inode = NULL;
-
+	inode_dir_lock_shared(dir->inode);
+	switch (dcache_lookup(parent, name, &e.inode_sector))
+	{
+	case DCACHE_HIT:
+		found = true;
+		break;
+	case DCACHE_NEGATIVE:
+		found = false;
+		break;
+	default:
+		found = lookup(dir, name, &e, NULL, NULL);
+		dcache_insert(parent, name, found, found ? e.inode_sector : 0);
+		break;
+	}
+	// 참조를 잡은 뒤에 lock을 놓아야 지워진 sector가 다시 쓰이지 않는다
+	*inode = found ? inode_open(e.inode_sector) : NULL;
+	inode_dir_unlock(dir->inode);
 	return *inode != NULL;
 }
 
@@ -158,6 +398,7 @@ bool dir_lookup(const struct dir *dir, const char *name,
 bool dir_add(struct dir *dir, const char *name, disk_sector_t inode_sector)
 {
 	struct dir_entry e;
+	uint32_t *hint = NULL;
 	off_t ofs;
 	bool success = false;
 
@@ -168,28 +409,44 @@ bool dir_add(struct dir *dir, const char *name, disk_sector_t inode_sector)
 	if (*name == '\0' || strlen(name) > NAME_MAX)
 		return false;
 
-	/* Check that NAME is not in use. */
-	if (lookup(dir, name, NULL, NULL))
-		goto done;
+	/* Lookup and slot choice must not race with another dir_add(). */
+	inode_dir_lock(dir->inode);
 
-	/* Set OFS to offset of free slot.
+	/* Check that NAME is not in use, and set OFS to the offset of
+	 * a free slot in the same pass.
 	 * If there are no free slots, then it will be set to the
-	 * current end-of-file.
+	 * current end-of-file, or to -1 in a hashed directory.
+	 * A hashed directory that already knows a free slot in NAME's
+	 * bucket takes that one, and the pass only looks for NAME.
 
 	 * inode_read_at() will only return a short read at end of file.
 	 * Otherwise, we'd need to verify that we didn't get a short
 	 * read due to something intermittent such as low memory. */
-	for (ofs = 0; inode_read_at(dir->inode, &e, sizeof e, ofs) == sizeof e;
-		 ofs += sizeof e)
-		if (!e.in_use)
-			break;
+	if (dir->hashed && dir_hints(dir) != NULL)
+		hint = &dir_hints(dir)[dir_bucket(name)];
+	if (lookup(dir, name, NULL, NULL, hint != NULL && *hint != 0 ? NULL : &ofs))
+		goto done;
+	if (hint != NULL && *hint != 0)
+		ofs = *hint;
+
 	/* Write slot. */
+	memset(&e, 0, sizeof e);
 	e.in_use = true;
 	strlcpy(e.name, name, sizeof e.name);
 	e.inode_sector = inode_sector;
-	success = inode_write_at(dir->inode, &e, sizeof e, ofs) == sizeof e;
+	if (!dir->hashed)
+		success = inode_write_at(dir->inode, &e, sizeof e, ofs) == sizeof e;
+	else if (ofs != -1)
+		success = hashed_put(dir, &e, ofs, 1);
+	else
+		success = hashed_add_leaf(dir, &e);
+	if (success)
+		dcache_insert(inode_get_inumber(dir->inode), name, true, inode_sector);
+	else
+		dcache_invalidate(inode_get_inumber(dir->inode), name);
 
 done:
+	inode_dir_unlock(dir->inode);
 	return success;
 }
 
@@ -206,8 +463,10 @@ bool dir_remove(struct dir *dir, const char *name)
 	ASSERT(dir != NULL);
 	ASSERT(name != NULL);
 
+	inode_dir_lock(dir->inode);
+
 	/* Find directory entry. */
-	if (!lookup(dir, name, &e, &ofs))
+	if (!lookup(dir, name, &e, &ofs, NULL))
 		goto done;
 
 	/* Open inode. */
@@ -217,14 +476,18 @@ bool dir_remove(struct dir *dir, const char *name)
 
 	/* Erase directory entry. */
 	e.in_use = false;
-	if (inode_write_at(dir->inode, &e, sizeof e, ofs) != sizeof e)
+	if (dir->hashed ? !hashed_put(dir, &e, ofs, -1)
+					: inode_write_at(dir->inode, &e, sizeof e, ofs) != sizeof e)
 		goto done;
 
-	/* Remove inode. */
+	/* Remove inode and forget it.  What a removed directory held is
+	 * purged once its last opener closes it. */
+	dcache_insert(inode_get_inumber(dir->inode), name, false, 0);
 	inode_remove(inode);
 	success = true;
 
 done:
+	inode_dir_unlock(dir->inode);
 	inode_close(inode);
 	return success;
 }
@@ -236,8 +499,20 @@ bool dir_readdir(struct dir *dir, char name[NAME_MAX + 1])
 {
 	struct dir_entry e;
 
-	while (inode_read_at(dir->inode, &e, sizeof e, dir->pos) == sizeof e)
+	while (true)
 	{
+		if (dir->hashed)
+		{
+			/* Skip the header block and leaf headers. */
+			off_t in_block = dir->pos % DIR_BLOCK_SIZE;
+
+			if (dir->pos < DIR_BLOCK_SIZE)
+				dir->pos = leaf_entry_ofs(1, 0);
+			else if (in_block < leaf_entry_ofs(0, 0))
+				dir->pos += leaf_entry_ofs(0, 0) - in_block;
+		}
+		if (inode_read_at(dir->inode, &e, sizeof e, dir->pos) != sizeof e)
+			break;
 		dir->pos += sizeof e;
 		if (e.in_use)
 		{
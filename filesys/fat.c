@@ -2,8 +2,10 @@
 #include "devices/disk.h"
 #include "filesys/filesys.h"
 #include "filesys/directory.h"
+#include "filesys/page_cache.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
+#include <bitmap.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -16,8 +18,18 @@ struct fat_boot
 	unsigned int fat_start;
 	unsigned int fat_sectors; /* Size of FAT in sectors. */
 	unsigned int root_dir_cluster;
+	unsigned int flags;
 };
 
+/* fat_boot.flags. */
+#define FAT_BOOT_EXTENTS 0x1 /* New inodes index their clusters by extents. */
+
+/* Number of FAT entries held by one FAT sector. */
+#define FAT_ENTRIES_PER_SECTOR (DISK_SECTOR_SIZE / sizeof(cluster_t))
+
+/* Number of dirty FAT sectors fat_flush() copies out at a time. */
+#define FAT_FLUSH_SECTORS 8
+
 /* FAT FS */
 struct fat_fs
 {
@@ -25,14 +37,21 @@ struct fat_fs
 	unsigned int *fat;
 	unsigned int fat_length;
 	disk_sector_t data_start;
-	cluster_t last_clst;
-	struct lock write_lock;
+	cluster_t last_clst;		/* Next-fit hint: where to look for free clusters. */
+	size_t free_cnt;			/* Number of free clusters. */
+	struct bitmap *used_map;	/* One bit per cluster, set if in use. */
+	struct bitmap *dirty_map;	/* One bit per FAT sector, set if not yet on disk. */
+	struct lock alloc_lock;		/* Guards changes to the FAT. */
+	struct lock flush_lock;		/* Serializes fat_flush(). */
+	uint8_t *flush_buf;			/* FAT_FLUSH_SECTORS sectors for fat_flush(). */
 };
 
 static struct fat_fs *fat_fs;
 
 void fat_boot_create(void);
 void fat_fs_init(void);
+static void fat_build_used_map(void);
+static void fat_copy_sector(size_t idx, uint8_t *buf);
 
 void fat_init(void)
 {
@@ -55,35 +74,35 @@ void fat_init(void)
 
 void fat_open(void)
 {
+	/* Right after fat_create() the tables in memory are already the
+	 * ones on disk; loading them again would leak the old ones. */
+	if (fat_fs->fat != NULL)
+		return;
+
 	fat_fs->fat = calloc(fat_fs->fat_length, sizeof(cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC("FAT load failed");
 
-	// Load FAT directly from the disk
+	// Load FAT directly from the disk, whole sectors in one transfer
 	uint8_t *buffer = (uint8_t *)fat_fs->fat;
-	off_t bytes_read = 0;
-	off_t bytes_left = sizeof(fat_fs->fat);
 	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof(cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++)
+	size_t full_sectors = fat_size_in_bytes / DISK_SECTOR_SIZE;
+	off_t bytes_left = fat_size_in_bytes % DISK_SECTOR_SIZE;
+
+	if (full_sectors > fat_fs->bs.fat_sectors)
+		full_sectors = fat_fs->bs.fat_sectors;
+	if (full_sectors > 0)
+		disk_read_multi(filesys_disk, fat_fs->bs.fat_start, buffer, full_sectors);
+	if (bytes_left > 0 && full_sectors < fat_fs->bs.fat_sectors)
 	{
-		bytes_left = fat_size_in_bytes - bytes_read;
-		if (bytes_left >= DISK_SECTOR_SIZE)
-		{
-			disk_read(filesys_disk, fat_fs->bs.fat_start + i,
-					  buffer + bytes_read);
-			bytes_read += DISK_SECTOR_SIZE;
-		}
-		else
-		{
-			uint8_t *bounce = malloc(DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC("FAT load failed");
-			disk_read(filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			memcpy(buffer + bytes_read, bounce, bytes_left);
-			bytes_read += bytes_left;
-			free(bounce);
-		}
+		uint8_t *bounce = malloc(DISK_SECTOR_SIZE);
+		if (bounce == NULL)
+			PANIC("FAT load failed");
+		disk_read(filesys_disk, fat_fs->bs.fat_start + full_sectors, bounce);
+		memcpy(buffer + full_sectors * DISK_SECTOR_SIZE, bounce, bytes_left);
+		free(bounce);
 	}
+	fat_build_used_map();
 }
 
 void fat_close(void)
@@ -96,43 +115,24 @@ void fat_close(void)
 	disk_write(filesys_disk, FAT_BOOT_SECTOR, bounce);
 	free(bounce);
 
-	// Write FAT directly to the disk
-	uint8_t *buffer = (uint8_t *)fat_fs->fat;
-	off_t bytes_wrote = 0;
-	off_t bytes_left = sizeof(fat_fs->fat);
-	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof(cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++)
-	{
-		bytes_left = fat_size_in_bytes - bytes_wrote;
-		if (bytes_left >= DISK_SECTOR_SIZE)
-		{
-			disk_write(filesys_disk, fat_fs->bs.fat_start + i,
-					   buffer + bytes_wrote);
-			bytes_wrote += DISK_SECTOR_SIZE;
-		}
-		else
-		{
-			bounce = calloc(1, DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC("FAT close failed");
-			memcpy(bounce, buffer + bytes_wrote, bytes_left);
-			disk_write(filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			bytes_wrote += bytes_left;
-			free(bounce);
-		}
-	}
+	// 바뀐 FAT sector만 기록
+	fat_flush();
 }
 
-void fat_create(void)
+void fat_create(bool extents)
 {
 	// Create FAT boot
 	fat_boot_create();
+	if (extents)
+		fat_fs->bs.flags |= FAT_BOOT_EXTENTS;
 	fat_fs_init();
 
 	// Create FAT table
 	fat_fs->fat = calloc(fat_fs->fat_length, sizeof(cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC("FAT creation failed");
+	fat_build_used_map();
+	bitmap_set_all(fat_fs->dirty_map, true); // 새 FAT는 전부 기록해야 함
 
 	// Set up ROOT_DIR_CLST
 	fat_put(ROOT_DIR_CLUSTER, EOChain);
@@ -159,13 +159,181 @@ void fat_fs_init(void)
 	/* TODO: Your code goes here. */
 	fat_fs->fat_length = fat_fs->bs.total_sectors / SECTORS_PER_CLUSTER;
 	fat_fs->data_start = fat_fs->bs.fat_start + fat_fs->bs.fat_sectors;
-	lock_init(&fat_fs->write_lock);
+	lock_init(&fat_fs->alloc_lock);
+	lock_init(&fat_fs->flush_lock);
+	if (fat_fs->flush_buf == NULL) // fat_create()에서 다시 불릴 수 있음
+		fat_fs->flush_buf = malloc(FAT_FLUSH_SECTORS * DISK_SECTOR_SIZE);
+	if (fat_fs->flush_buf == NULL)
+		PANIC("FAT init failed");
+}
+
+/* Builds the in-memory free-cluster index from the loaded FAT.
+ * Clusters 0 and 1 and those whose sectors would lie past the end
+ * of the disk or whose entries lie past the on-disk FAT are never
+ * handed out. */
+static void
+fat_build_used_map(void)
+{
+	size_t data_clusters = (fat_fs->bs.total_sectors - fat_fs->data_start) / SECTORS_PER_CLUSTER;
+
+	// FAT sector에 담기지 않는 cluster도 쓰지 않음
+	if (data_clusters > fat_fs->bs.fat_sectors * FAT_ENTRIES_PER_SECTOR)
+		data_clusters = fat_fs->bs.fat_sectors * FAT_ENTRIES_PER_SECTOR;
+
+	fat_fs->used_map = bitmap_create(fat_fs->fat_length);
+	if (fat_fs->used_map == NULL)
+		PANIC("FAT free map creation failed");
+	fat_fs->free_cnt = 0;
+	for (size_t i = 0; i < fat_fs->fat_length; i++)
+	{
+		bool used = i <= ROOT_DIR_CLUSTER || i >= data_clusters || fat_fs->fat[i] != 0;
+		bitmap_set(fat_fs->used_map, i, used);
+		if (!used)
+			fat_fs->free_cnt++;
+	}
+	fat_fs->last_clst = ROOT_DIR_CLUSTER + 1;
+
+	fat_fs->dirty_map = bitmap_create(fat_fs->bs.fat_sectors);
+	if (fat_fs->dirty_map == NULL)
+		PANIC("FAT dirty map creation failed");
 }
 
 /*----------------------------------------------------------------------------*/
 /* FAT handling                                                               */
 /*----------------------------------------------------------------------------*/
 
+/* Sets FAT entry CLST to VAL and keeps the free-cluster index in
+ * step, but does not mark the entry's FAT sector dirty.
+ * alloc_lock must be held. */
+static void
+fat_store(cluster_t clst, cluster_t val)
+{
+	bool was_used = bitmap_test(fat_fs->used_map, clst);
+
+	fat_fs->fat[clst] = val;
+	if (was_used && val == 0)
+		fat_fs->free_cnt++;
+	else if (!was_used && val != 0)
+		fat_fs->free_cnt--;
+	bitmap_set(fat_fs->used_map, clst, val != 0);
+}
+
+/* Sets FAT entry CLST to VAL, as fat_store() does, and marks its
+ * FAT sector dirty.  alloc_lock must be held. */
+static void
+fat_set(cluster_t clst, cluster_t val)
+{
+	fat_store(clst, val);
+	bitmap_mark(fat_fs->dirty_map, clst / FAT_ENTRIES_PER_SECTOR);
+}
+
+/* Finds free clusters for an allocation of WANT clusters, next-fit
+ * from last_clst.  Returns the first cluster of a run of WANT free
+ * clusters if there is one; otherwise returns the first free
+ * cluster and stores in *GOT how many free clusters follow it.
+ * There must be at least one free cluster.  alloc_lock must be
+ * held. */
+static cluster_t
+fat_find_run(size_t want, size_t *got)
+{
+	size_t idx = bitmap_scan(fat_fs->used_map, fat_fs->last_clst, want, false);
+	if (idx == BITMAP_ERROR)
+		idx = bitmap_scan(fat_fs->used_map, 0, want, false);
+	if (idx != BITMAP_ERROR)
+	{
+		*got = want;
+		return idx;
+	}
+
+	// 연속된 공간이 없으면 처음 보이는 빈 cluster부터 이어지는 만큼만
+	idx = bitmap_scan(fat_fs->used_map, fat_fs->last_clst, 1, false);
+	if (idx == BITMAP_ERROR)
+		idx = bitmap_scan(fat_fs->used_map, 0, 1, false);
+	ASSERT(idx != BITMAP_ERROR);
+	*got = 1;
+	while (*got < want && idx + *got < fat_fs->fat_length && !bitmap_test(fat_fs->used_map, idx + *got))
+		(*got)++;
+	return idx;
+}
+
+/* Appends CNT clusters to the chain ending at CLST, or starts a new
+ * chain of CNT clusters if CLST is 0.  The clusters are contiguous
+ * on disk when a long enough free run exists.  The new clusters are
+ * first reserved and chained among themselves without marking their
+ * FAT sectors dirty.  If ZERO, they are then zeroed in the buffer
+ * cache with alloc_lock dropped, and only after that are they linked
+ * to CLST and scheduled for write-back, so fat_flush() never writes
+ * a FAT sector that reaches a cluster before the cluster's zeroes.
+ * Returns the first new cluster, or 0 without allocating anything
+ * if fewer than CNT clusters are free. */
+static cluster_t
+fat_alloc_chain(cluster_t clst, size_t cnt, bool zero)
+{
+	static char zeros[DISK_SECTOR_SIZE];
+	cluster_t first = 0;
+	cluster_t last = 0;
+	cluster_t c;
+
+	ASSERT(cnt > 0);
+
+	lock_acquire(&fat_fs->alloc_lock);
+	if (fat_fs->free_cnt < cnt)
+	{
+		lock_release(&fat_fs->alloc_lock);
+		return 0;
+	}
+	while (cnt > 0)
+	{
+		size_t got;
+		cluster_t run = fat_find_run(cnt, &got);
+
+		if (first == 0)
+			first = run;
+		for (size_t i = 0; i < got; i++)
+		{
+			if (last != 0)
+				fat_store(last, run + i);
+			fat_store(run + i, EOChain);
+			last = run + i;
+		}
+		cnt -= got;
+		fat_fs->last_clst = last + 1 < fat_fs->fat_length ? last + 1 : 0;
+	}
+	lock_release(&fat_fs->alloc_lock);
+
+	// 예약한 cluster는 아직 어느 chain에도 연결되지 않아 lock 없이 채울 수 있음
+	if (zero)
+		for (c = first;; c = fat_fs->fat[c])
+		{
+			for (int j = 0; j < SECTORS_PER_CLUSTER; j++)
+				buffer_cache_write(cluster_to_sector(c) + j, zeros, 0, DISK_SECTOR_SIZE);
+			if (c == last)
+				break;
+		}
+
+	lock_acquire(&fat_fs->alloc_lock);
+	for (c = first;; c = fat_fs->fat[c])
+	{
+		bitmap_mark(fat_fs->dirty_map, c / FAT_ENTRIES_PER_SECTOR);
+		if (c == last)
+			break;
+	}
+	if (clst != 0)
+		fat_set(clst, first);
+	lock_release(&fat_fs->alloc_lock);
+
+	return first;
+}
+
+/* Appends CNT zeroed clusters to the chain ending at CLST, or starts
+ * a new chain of CNT clusters if CLST is 0, as fat_alloc_chain()
+ * does.  For file data. */
+cluster_t
+fat_create_chain_multi(cluster_t clst, size_t cnt)
+{
+	return fat_alloc_chain(clst, cnt, true);
+}
+
 /* Add a cluster to the chain.
  * If CLST is 0, start a new chain.
  * Returns 0 if fails to allocate a new cluster. */
@@ -173,21 +341,8 @@ cluster_t
 fat_create_chain(cluster_t clst)
 {
 	/* TODO: Your code goes here. */
-	lock_acquire(&fat_fs->write_lock);
-	for (int i = 2; i < fat_fs->fat_length; i++)
-	{
-		if (fat_fs->fat[i] == 0)
-		{
-			if (clst != 0)
-				fat_fs->fat[clst] = i;
-			fat_fs->fat[i] = EOChain;
-			lock_release(&fat_fs->write_lock);
-			return i;
-		}
-	}
-	lock_release(&fat_fs->write_lock);
-
-	return 0;
+	// inode 등 호출자가 바로 채우는 cluster라 0으로 채우지 않음
+	return fat_alloc_chain(clst, 1, false);
 }
 
 /* Remove the chain of clusters starting from CLST.
@@ -196,28 +351,100 @@ void fat_remove_chain(cluster_t clst, cluster_t pclst)
 {
 	/* TODO: Your code goes here. */
 	cluster_t next_clst = clst;
+	lock_acquire(&fat_fs->alloc_lock);
 	while (true)
 	{
 		if (fat_fs->fat[next_clst] == EOChain)
 		{
-			fat_fs->fat[next_clst] = 0;
+			fat_set(next_clst, 0);
 			break;
 		}
 		next_clst = fat_fs->fat[next_clst];
-		fat_fs->fat[clst] = 0;
+		fat_set(clst, 0);
 		clst = next_clst;
 	}
 	if (pclst)
-		fat_fs->fat[pclst] = EOChain;
-	for (int i = fat_fs->bs.fat_start; i < fat_fs->data_start; i++)
-		disk_write(filesys_disk, i, fat_fs->fat + DISK_SECTOR_SIZE * i);
+		fat_set(pclst, EOChain);
+	lock_release(&fat_fs->alloc_lock);
+}
+
+/* Copies FAT sector IDX (relative to fat_start) into BUF, which
+ * must hold DISK_SECTOR_SIZE bytes.  alloc_lock must be held. */
+static void
+fat_copy_sector(size_t idx, uint8_t *buf)
+{
+	size_t first = idx * FAT_ENTRIES_PER_SECTOR;
+	size_t cnt = FAT_ENTRIES_PER_SECTOR;
+
+	// 마지막 sector는 FAT 배열이 sector 끝까지 차지 않을 수 있음
+	if (first + cnt > fat_fs->fat_length)
+		cnt = first < fat_fs->fat_length ? fat_fs->fat_length - first : 0;
+	memset(buf, 0, DISK_SECTOR_SIZE);
+	memcpy(buf, fat_fs->fat + first, cnt * sizeof(cluster_t));
+}
+
+/* Writes the buffer cache and then every FAT sector changed since
+ * the last flush to disk, in ascending sector order, one transfer
+ * per run of dirty sectors.  Dirty FAT sectors are copied out
+ * FAT_FLUSH_SECTORS at a time under alloc_lock, and the disk is
+ * only touched after the lock is dropped, so allocation never waits
+ * for I/O.  fat_alloc_chain() zeroes new data clusters before it
+ * links them, so a copied sector that links a cluster was taken
+ * after the zeroes reached the buffer cache, and the cache flush
+ * that follows the copy writes them first.  Freed clusters reach
+ * the on-disk FAT at the next flush; a crash before it only leaks
+ * them. */
+void fat_flush(void)
+{
+	size_t idx = 0;
+	bool more = true;
+
+	lock_acquire(&fat_fs->flush_lock);
+	while (more)
+	{
+		size_t sectors[FAT_FLUSH_SECTORS];
+		size_t cnt = 0;
+
+		lock_acquire(&fat_fs->alloc_lock);
+		while (cnt < FAT_FLUSH_SECTORS
+			   && (idx = bitmap_scan(fat_fs->dirty_map, idx, 1, true)) != BITMAP_ERROR)
+		{
+			fat_copy_sector(idx, fat_fs->flush_buf + cnt * DISK_SECTOR_SIZE);
+			bitmap_reset(fat_fs->dirty_map, idx);
+			sectors[cnt++] = idx++;
+		}
+		lock_release(&fat_fs->alloc_lock);
+		more = cnt == FAT_FLUSH_SECTORS;
+
+		buffer_cache_flush(); // 데이터가 디스크에 간 뒤에 FAT를 기록
+		for (size_t i = 0; i < cnt;)
+		{
+			size_t end = i + 1;
+
+			while (end < cnt && sectors[end] == sectors[end - 1] + 1)
+				end++;
+			disk_write_multi(filesys_disk, fat_fs->bs.fat_start + sectors[i],
+							 fat_fs->flush_buf + i * DISK_SECTOR_SIZE, end - i);
+			i = end;
+		}
+	}
+	lock_release(&fat_fs->flush_lock);
 }
 
 /* Update a value in the FAT table. */
 void fat_put(cluster_t clst, cluster_t val)
 {
 	/* TODO: Your code goes here. */
-	fat_fs->fat[clst] = val;
+	lock_acquire(&fat_fs->alloc_lock);
+	fat_set(clst, val);
+	lock_release(&fat_fs->alloc_lock);
+}
+
+/* Returns true if the file system was formatted to index new
+ * inodes by extents. */
+bool fat_extents_enabled(void)
+{
+	return fat_fs->bs.flags & FAT_BOOT_EXTENTS;
 }
 
 /* Fetch a value in the FAT table. */
@@ -1,14 +1,30 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
+#include "filesys/fat.h"
+#include "filesys/page_cache.h"
 #include "threads/malloc.h"
 
+/* First read-ahead window, in sectors: half a cluster. */
+#define RA_MIN_WINDOW (SECTORS_PER_CLUSTER / 2)
+
+/* Largest read-ahead window, in sectors: a quarter of the buffer
+ * cache, so that one sequential reader cannot push out most of the
+ * sectors everybody else is using, but at least two clusters, so
+ * that the window still grows from RA_MIN_WINDOW with a small
+ * cache. */
+#define RA_MAX_WINDOW \
+	(BUFFER_CACHE_SIZE / 4 > 2 * SECTORS_PER_CLUSTER ? BUFFER_CACHE_SIZE / 4 : 2 * SECTORS_PER_CLUSTER)
+
 /* An open file. */
 struct file
 {
 	struct inode *inode; /* File's inode. */
 	off_t pos;			 /* Current position. */
 	bool deny_write;	 /* Has file_deny_write() been called? */
+	off_t ra_next;		 /* Where a sequential read would start. */
+	off_t ra_end;		 /* End of the read-ahead issued so far. */
+	int ra_window;		 /* Read-ahead window in sectors, 0: random. */
 };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -23,6 +39,9 @@ file_open(struct inode *inode)
 		file->inode = inode;
 		file->pos = 0;
 		file->deny_write = false;
+		file->ra_next = 0;
+		file->ra_end = 0;
+		file->ra_window = 0;
 		return file;
 	}
 	else
@@ -79,6 +98,41 @@ file_get_inode(struct file *file)
 	return file->inode;
 }
 
+/* Tracks the access pattern of FILE after BYTES_READ bytes were
+ * read at OFS.  A read that starts where the last one ended opens
+ * the read-ahead window at RA_MIN_WINDOW sectors or doubles it, up
+ * to RA_MAX_WINDOW, and queues that much beyond the read for the
+ * buffer cache.  Any other read closes the window again. */
+static void
+file_readahead(struct file *file, off_t ofs, off_t bytes_read)
+{
+	off_t end = ofs + bytes_read;
+	off_t ra_start, ra_end;
+
+	if (ofs != file->ra_next || bytes_read == 0)
+	{
+		file->ra_window = 0;
+		file->ra_end = 0;
+		file->ra_next = end;
+		return;
+	}
+	file->ra_next = end;
+	if (file->ra_window < RA_MAX_WINDOW && end >= file->ra_end)
+	{
+		file->ra_window = file->ra_window ? file->ra_window * 2 : RA_MIN_WINDOW;
+		if (file->ra_window > RA_MAX_WINDOW)
+			file->ra_window = RA_MAX_WINDOW;
+	}
+
+	ra_start = file->ra_end > end ? file->ra_end : end;
+	ra_end = end + file->ra_window * DISK_SECTOR_SIZE;
+	if (ra_start < ra_end)
+	{
+		inode_readahead(file->inode, ra_start, ra_end - ra_start);
+		file->ra_end = ra_end;
+	}
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
  * starting at the file's current position.
  * Returns the number of bytes actually read,
@@ -87,6 +141,7 @@ file_get_inode(struct file *file)
 off_t file_read(struct file *file, void *buffer, off_t size)
 {
 	off_t bytes_read = inode_read_at(file->inode, buffer, size, file->pos);
+	file_readahead(file, file->pos, bytes_read);
 	file->pos += bytes_read;
 	return bytes_read;
 }
@@ -98,7 +153,9 @@ off_t file_read(struct file *file, void *buffer, off_t size)
  * The file's current position is unaffected. */
 off_t file_read_at(struct file *file, void *buffer, off_t size, off_t file_ofs)
 {
-	return inode_read_at(file->inode, buffer, size, file_ofs);
+	off_t bytes_read = inode_read_at(file->inode, buffer, size, file_ofs);
+	file_readahead(file, file_ofs, bytes_read);
+	return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
@@ -6,13 +6,18 @@
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/dcache.h"
 #include "devices/disk.h"
 #include "filesys/fat.h"
+#include "filesys/page_cache.h"
 #include "threads/thread.h"
 
 /* The disk that contains the file system. */
 struct disk *filesys_disk;
 
+/* Set by the -extents kernel option. */
+bool filesys_format_extents;
+
 static void do_format(void);
 
 /* Initializes the file system module.
@@ -23,7 +28,9 @@ void filesys_init(bool format)
 	if (filesys_disk == NULL)
 		PANIC("hd0:1 (hdb) not present, file system initialization failed");
 
+	buffer_cache_init();
 	inode_init();
+	dcache_init();
 
 #ifdef EFILESYS
 	fat_init();
@@ -41,12 +48,18 @@ void filesys_init(bool format)
 
 	free_map_open();
 #endif
+
+	/* The buffer cache is used with either layout, so its flush and
+	 * read-ahead daemons are needed with either. */
+	pagecache_init();
 }
 
 /* Shuts down the file system module, writing any unwritten data
  * to disk. */
 void filesys_done(void)
 {
+	buffer_cache_flush();
+
 	/* Original FS */
 #ifdef EFILESYS
 	fat_close();
@@ -146,7 +159,7 @@ do_format(void)
 
 #ifdef EFILESYS
 	/* Create FAT and save it to the disk. */
-	fat_create();
+	fat_create(filesys_format_extents);
 	fat_close();
 #else
 	free_map_create();
@@ -1,27 +1,78 @@
 #include "filesys/inode.h"
 #include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
 #include "filesys/fat.h"
+#include "filesys/page_cache.h"
+#include "filesys/dcache.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* A run of LEN contiguous clusters starting at START that holds
+ * clusters IDX through IDX + LEN - 1 of a file. */
+struct extent
+{
+	uint32_t idx;
+	cluster_t start;
+	uint32_t len;
+};
+
+/* Number of extents kept in the on-disk inode itself. */
+#define INODE_EXTENT_CNT 40
+
+/* inode_disk.flags. */
+#define INODE_EXTENTS 0x1 /* extents[] index the FAT chain. */
+
 /* On-disk inode.
- * Must be exactly DISK_SECTOR_SIZE bytes long. */
+ * Must be exactly DISK_SECTOR_SIZE bytes long.
+ *
+ * The data always lives on a FAT chain starting at START.  With
+ * INODE_EXTENTS set, the chain is also described as a sorted list
+ * of extents, the first INODE_EXTENT_CNT here and the rest in an
+ * overflow extent block, so that lookups need not walk the chain.
+ * Inodes from disks that predate extents have FLAGS zero. */
 struct inode_disk
 {
 	disk_sector_t start; /* First data sector. */
 	off_t length;		 /* File size in bytes. */
 	int is_dir;
-	unsigned magic;		  /* Magic number. */
-	uint32_t unused[124]; /* Not used. */
+	unsigned magic;							 /* Magic number. */
+	uint32_t flags;							 /* INODE_* flags. */
+	uint32_t extent_cnt;					 /* Extents in use, overflow included. */
+	cluster_t overflow;						 /* Overflow extent block, 0 if none. */
+	struct extent extents[INODE_EXTENT_CNT]; /* First extents. */
+	uint32_t unused[1];						 /* Not used. */
 };
 
+/* One sector of the overflow extent block, which is one cluster
+ * large.  Must be exactly DISK_SECTOR_SIZE bytes long. */
+#define EXTENTS_PER_SECTOR 42
+struct extent_sector
+{
+	struct extent extents[EXTENTS_PER_SECTOR];
+	uint32_t unused[2];
+};
+
+/* Most extents an inode can have. */
+#define EXTENT_MAX (INODE_EXTENT_CNT + EXTENTS_PER_SECTOR * SECTORS_PER_CLUSTER)
+
+/* Bytes in a cluster. */
+#define CLUSTER_SIZE (DISK_SECTOR_SIZE * SECTORS_PER_CLUSTER)
+
+/* The in-memory inode remembers where cluster I * INODE_SKIP_STRIDE
+ * of its chain is, for I < INODE_SKIP_CNT, so that a random access
+ * walks at most INODE_SKIP_STRIDE FAT entries in small files. */
+#define INODE_SKIP_STRIDE 16
+#define INODE_SKIP_CNT 32
+
 /* Returns the number of sectors to allocate for an inode SIZE
  * bytes long. */
 static inline size_t
@@ -33,45 +84,268 @@ bytes_to_sectors(off_t size)
 /* In-memory inode. */
 struct inode
 {
-	struct list_elem elem;	/* Element in inode list. */
+	struct hash_elem elem;	/* Element in open_inodes. */
 	disk_sector_t sector;	/* Sector number of disk location. */
 	int open_cnt;			/* Number of openers. */
 	bool removed;			/* True if deleted, false otherwise. */
+	bool loading;			/* True while being read from disk. */
+	bool load_failed;		/* True if reading it failed. */
+	struct condition loaded; /* Signaled when loading ends. */
 	int deny_write_cnt;		/* 0: writes ok, >0: deny writes. */
+	struct rwlock rwlock;	/* Guards data and deny_write_cnt. */
+	struct rwlock dir_lock;	/* Guards the entries of a directory. */
+	uint32_t *dir_hints;	/* Directory's own hints, guarded by dir_lock. */
 	struct inode_disk data; /* Inode content. */
+	struct extent_sector *overflow; /* Overflow extent block, if any. */
+
+	/* Hints into the FAT chain.  Clusters are only ever appended, so
+	 * a hint never goes stale while the inode is open. */
+	struct lock cursor_lock;			/* Guards the members below. */
+	size_t cursor_idx;					/* Index of the last cluster looked up... */
+	cluster_t cursor_clst;				/* ...and its number, 0 if none. */
+	cluster_t skip[INODE_SKIP_CNT];		/* Cluster I * INODE_SKIP_STRIDE, 0 if unknown. */
 };
 
+/* Returns extent I of the inode DATA whose overflow extent block
+ * is loaded at OVERFLOW. */
+static struct extent *
+extent_at(struct inode_disk *data, struct extent_sector *overflow, size_t i)
+{
+	if (i < INODE_EXTENT_CNT)
+		return &data->extents[i];
+	i -= INODE_EXTENT_CNT;
+	return &overflow[i / EXTENTS_PER_SECTOR].extents[i % EXTENTS_PER_SECTOR];
+}
+
+/* Records CLST as the next cluster of DATA, merging it into the
+ * last extent if it is contiguous with it.  Allocates the overflow
+ * extent block on demand.  Returns false if DATA has no room for
+ * another extent. */
+static bool
+extent_append(struct inode_disk *data, struct extent_sector **overflow, cluster_t clst)
+{
+	struct extent *last = NULL;
+	uint32_t idx = 0;
+
+	if (data->extent_cnt > 0)
+	{
+		last = extent_at(data, *overflow, data->extent_cnt - 1);
+		if (last->start + last->len == clst)
+		{
+			last->len++;
+			return true;
+		}
+		idx = last->idx + last->len;
+	}
+	if (data->extent_cnt == EXTENT_MAX)
+		return false;
+	if (data->extent_cnt == INODE_EXTENT_CNT && *overflow == NULL)
+	{
+		*overflow = calloc(SECTORS_PER_CLUSTER, sizeof **overflow);
+		if (*overflow == NULL)
+			return false;
+		data->overflow = fat_create_chain(0);
+		if (data->overflow == 0)
+		{
+			free(*overflow);
+			*overflow = NULL;
+			return false;
+		}
+	}
+	*extent_at(data, *overflow, data->extent_cnt++) = (struct extent){
+		.idx = idx,
+		.start = clst,
+		.len = 1,
+	};
+	return true;
+}
+
+/* Stops indexing DATA by extents, leaving the FAT chain as the
+ * only description of its clusters. */
+static void
+extent_drop(struct inode_disk *data, struct extent_sector **overflow)
+{
+	if (data->overflow != 0)
+		fat_remove_chain(data->overflow, 0);
+	free(*overflow);
+	*overflow = NULL;
+	data->flags &= ~INODE_EXTENTS;
+	data->extent_cnt = 0;
+	data->overflow = 0;
+	memset(data->extents, 0, sizeof data->extents);
+}
+
+/* Adds the chain starting at CLST to the extents of DATA and
+ * writes the overflow extent block through the buffer cache.  The
+ * inode sector itself is left to the caller.  Falls back to plain
+ * chain mode if the extents do not fit. */
+static void
+extent_add_chain(struct inode_disk *data, struct extent_sector **overflow, cluster_t clst)
+{
+	if (!(data->flags & INODE_EXTENTS))
+		return;
+	for (; clst != EOChain; clst = fat_get(clst))
+		if (!extent_append(data, overflow, clst))
+		{
+			extent_drop(data, overflow);
+			return;
+		}
+	if (data->overflow != 0)
+	{
+		size_t used = DIV_ROUND_UP(data->extent_cnt - INODE_EXTENT_CNT, EXTENTS_PER_SECTOR);
+		for (size_t i = 0; i < used; i++)
+			buffer_cache_write(cluster_to_sector(data->overflow) + i, &(*overflow)[i], 0, DISK_SECTOR_SIZE);
+	}
+}
+
+/* Returns cluster IDX of INODE by binary search over its extents,
+ * or EOChain if INODE has fewer clusters. */
+static cluster_t
+extent_lookup(struct inode *inode, size_t idx)
+{
+	size_t lo = 0;
+	size_t hi = inode->data.extent_cnt;
+
+	while (lo < hi)
+	{
+		size_t mid = (lo + hi) / 2;
+		struct extent *e = extent_at(&inode->data, inode->overflow, mid);
+
+		if (idx < e->idx)
+			hi = mid;
+		else if (idx >= e->idx + e->len)
+			lo = mid + 1;
+		else
+			return e->start + (idx - e->idx);
+	}
+	return EOChain;
+}
+
+/* Returns the number of the IDX'th cluster in INODE's chain, or
+ * EOChain if the chain is shorter.  Extent-indexed inodes are
+ * searched directly.  Otherwise the walk starts from the closest
+ * hint at or before IDX, so sequential lookups cost one fat_get()
+ * at most. */
+static cluster_t
+inode_cluster(struct inode *inode, size_t idx)
+{
+	size_t cur_idx = 0;
+	cluster_t clst = sector_to_cluster(inode->data.start);
+	size_t slot = idx / INODE_SKIP_STRIDE;
+
+	if (inode->data.flags & INODE_EXTENTS)
+		return extent_lookup(inode, idx);
+
+	lock_acquire(&inode->cursor_lock);
+	if (slot >= INODE_SKIP_CNT)
+		slot = INODE_SKIP_CNT - 1;
+	while (slot > 0 && inode->skip[slot] == 0)
+		slot--;
+	if (slot > 0)
+	{
+		cur_idx = slot * INODE_SKIP_STRIDE;
+		clst = inode->skip[slot];
+	}
+	if (inode->cursor_clst != 0 && cur_idx <= inode->cursor_idx && inode->cursor_idx <= idx)
+	{
+		cur_idx = inode->cursor_idx;
+		clst = inode->cursor_clst;
+	}
+	lock_release(&inode->cursor_lock);
+
+	while (cur_idx < idx)
+	{
+		clst = fat_get(clst);
+		if (clst == EOChain)
+			return EOChain;
+		cur_idx++;
+		if (cur_idx % INODE_SKIP_STRIDE == 0 && cur_idx / INODE_SKIP_STRIDE < INODE_SKIP_CNT)
+		{
+			lock_acquire(&inode->cursor_lock);
+			inode->skip[cur_idx / INODE_SKIP_STRIDE] = clst;
+			lock_release(&inode->cursor_lock);
+		}
+	}
+
+	lock_acquire(&inode->cursor_lock);
+	inode->cursor_idx = idx;
+	inode->cursor_clst = clst;
+	lock_release(&inode->cursor_lock);
+	return clst;
+}
+
 /* Returns the disk sector that contains byte offset POS within
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
  * POS. */
 static disk_sector_t
-byte_to_sector(const struct inode *inode, off_t pos)
+byte_to_sector(struct inode *inode, off_t pos)
 {
 	ASSERT(inode != NULL);
 	if (pos <= inode->data.length)
 	{
-		cluster_t clst = sector_to_cluster(inode->data.start);
-		int iter = pos / (DISK_SECTOR_SIZE * SECTORS_PER_CLUSTER);
-		int left = pos / DISK_SECTOR_SIZE - iter * SECTORS_PER_CLUSTER;
-		for (int i = 0; i < iter; i++)
-			clst = fat_get(clst);
+		cluster_t clst = inode_cluster(inode, pos / CLUSTER_SIZE);
 		if (clst == EOChain)
 			return EOChain;
-		return cluster_to_sector(clst) + left;
+		return cluster_to_sector(clst) + pos / DISK_SECTOR_SIZE % SECTORS_PER_CLUSTER;
 	}
 	else
 		return EOChain;
 }
 
-/* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
-static struct list open_inodes;
+/* Grows INODE's chain to at least CLST_CNT clusters.  The new ones
+ * come zeroed from fat_create_chain_multi().  Returns false if the
+ * disk is full. */
+static bool
+inode_extend(struct inode *inode, size_t clst_cnt)
+{
+	size_t idx = inode->data.length > 0 ? (inode->data.length - 1) / CLUSTER_SIZE : 0;
+	cluster_t clst = inode_cluster(inode, idx);
+	cluster_t next;
+
+	ASSERT(clst != EOChain);
+	while ((next = fat_get(clst)) != EOChain) // inode_create()가 미리 잡아둔 cluster
+	{
+		clst = next;
+		idx++;
+	}
+	if (idx + 1 >= clst_cnt)
+		return true;
+
+	// 모자란 cluster를 한 번에 잡아서 가능하면 연속으로 배치
+	next = fat_create_chain_multi(clst, clst_cnt - (idx + 1));
+	if (next == 0)
+		return false;
+	extent_add_chain(&inode->data, &inode->overflow, next);
+	return true;
+}
+
+/* Open inodes hashed by sector, so that opening a single inode
+ * twice returns the same `struct inode'. */
+static struct hash open_inodes;
+
+/* Guards open_inodes and the open_cnt, removed, loading and
+ * load_failed members of every inode in it. */
+static struct lock open_inodes_lock;
+
+static uint64_t
+open_inode_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	const struct inode *inode = hash_entry(e, struct inode, elem);
+	return hash_int(inode->sector);
+}
+
+static bool
+open_inode_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED)
+{
+	return hash_entry(a, struct inode, elem)->sector < hash_entry(b, struct inode, elem)->sector;
+}
 
 /* Initializes the inode module. */
 void inode_init(void)
 {
-	list_init(&open_inodes);
+	hash_init(&open_inodes, open_inode_hash, open_inode_less, NULL);
+	lock_init(&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -89,78 +363,149 @@ bool inode_create(disk_sector_t sector, off_t length, int is_dir)
 	/* If this assertion fails, the inode structure is not exactly
 	 * one sector in size, and you should fix that. */
 	ASSERT(sizeof *disk_inode == DISK_SECTOR_SIZE);
+	ASSERT(sizeof(struct extent_sector) == DISK_SECTOR_SIZE);
 	disk_inode = calloc(1, sizeof *disk_inode);
 	if (disk_inode != NULL)
 	{
 		size_t sectors = bytes_to_sectors(length);
 		size_t cluster_cnt = sectors / SECTORS_PER_CLUSTER;
+		cluster_t clst = fat_create_chain_multi(0, cluster_cnt + 1);
+		if (clst == 0)
+		{
+			free(disk_inode);
+			return false;
+		}
 		disk_inode->length = length;
 		disk_inode->magic = INODE_MAGIC;
-		disk_inode->start = cluster_to_sector(fat_create_chain(0));
+		disk_inode->start = cluster_to_sector(clst);
 		disk_inode->is_dir = is_dir;
-		cluster_t clst = sector_to_cluster(disk_inode->start);
-		for (int i = 0; i < cluster_cnt; i++)
-			clst = fat_create_chain(clst);
-		clst = sector_to_cluster(disk_inode->start);
-		disk_sector_t tmp;
-		disk_write(filesys_disk, sector, disk_inode);
-		if (sectors > 0)
+		if (fat_extents_enabled())
 		{
-			static char zeros[DISK_SECTOR_SIZE];
-
-			while (true)
-			{
-				if (clst == EOChain)
-					break;
-				tmp = cluster_to_sector(clst);
-				for (int i = 0; i < SECTORS_PER_CLUSTER; i++)
-				{
-					disk_write(filesys_disk, tmp + i, zeros);
-				}
-				clst = fat_get(clst);
-			}
+			struct extent_sector *overflow = NULL;
+
+			disk_inode->flags = INODE_EXTENTS;
+			extent_add_chain(disk_inode, &overflow, clst);
+			free(overflow);
 		}
+		buffer_cache_write(sector, disk_inode, 0, DISK_SECTOR_SIZE); // data cluster는 이미 0으로 채워져 있음
 		success = true;
 		free(disk_inode);
 	}
 	return success;
 }
 
+/* Reads INODE's on-disk inode, and its overflow extent block if
+ * it has one, into memory.  Returns false if memory allocation
+ * fails. */
+static bool
+inode_load(struct inode *inode)
+{
+	buffer_cache_read(inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	if (inode->sector == ROOT_DIR_SECTOR)
+	{
+		// root는 고정된 chain을 쓰고 extent를 두지 않음
+		inode->data.start = cluster_to_sector(ROOT_DIR_CLUSTER);
+		inode->data.flags = 0;
+		inode->data.extent_cnt = 0;
+		inode->data.overflow = 0;
+	}
+	if (inode->data.overflow != 0)
+	{
+		/* Without the overflow extents the open fails.  Clearing
+		 * INODE_EXTENTS instead would reach the disk on the next
+		 * write-back and leak the overflow cluster. */
+		inode->overflow = malloc(SECTORS_PER_CLUSTER * sizeof *inode->overflow);
+		if (inode->overflow == NULL)
+			return false;
+		for (int i = 0; i < SECTORS_PER_CLUSTER; i++)
+			buffer_cache_read(cluster_to_sector(inode->data.overflow) + i, &inode->overflow[i], 0, DISK_SECTOR_SIZE);
+	}
+	return true;
+}
+
+/* Drops one opener's reference to INODE, whose loading failed, and
+ * frees it if that was the last one.  open_inodes_lock must be
+ * held. */
+static void
+inode_drop_failed(struct inode *inode)
+{
+	if (--inode->open_cnt == 0)
+		free(inode);
+}
+
 /* Reads an inode from SECTOR
  * and returns a `struct inode' that contains it.
- * Returns a null pointer if memory allocation fails. */
+ * Returns a null pointer if memory allocation fails.
+ * The inode is read with open_inodes_lock dropped.  Meanwhile it
+ * sits in open_inodes marked as loading, and other openers of the
+ * same sector wait for it there. */
 struct inode *
 inode_open(disk_sector_t sector)
 {
-	struct list_elem *e;
+	struct inode key;
+	struct hash_elem *e;
 	struct inode *inode;
+	bool success;
+
+	lock_acquire(&open_inodes_lock);
 
 	/* Check whether this inode is already open. */
-	for (e = list_begin(&open_inodes); e != list_end(&open_inodes);
-		 e = list_next(e))
+	key.sector = sector;
+	e = hash_find(&open_inodes, &key.elem);
+	if (e != NULL)
 	{
-		inode = list_entry(e, struct inode, elem);
-		if (inode->sector == sector)
+		inode = hash_entry(e, struct inode, elem);
+		inode->open_cnt++;
+		while (inode->loading)
+			cond_wait(&inode->loaded, &open_inodes_lock);
+		if (inode->load_failed)
 		{
-			inode_reopen(inode);
-			return inode;
+			inode_drop_failed(inode);
+			inode = NULL;
 		}
+		lock_release(&open_inodes_lock);
+		return inode;
 	}
 
 	/* Allocate memory. */
 	inode = malloc(sizeof *inode);
 	if (inode == NULL)
+	{
+		lock_release(&open_inodes_lock);
 		return NULL;
+	}
 
 	/* Initialize. */
-	list_push_front(&open_inodes, &inode->elem);
 	inode->sector = sector;
+	hash_insert(&open_inodes, &inode->elem);
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
-	disk_read(filesys_disk, inode->sector, &inode->data);
-	if (sector == ROOT_DIR_SECTOR)
-		inode->data.start = cluster_to_sector(ROOT_DIR_CLUSTER);
+	inode->loading = true;
+	inode->load_failed = false;
+	cond_init(&inode->loaded);
+	rwlock_init(&inode->rwlock);
+	rwlock_init(&inode->dir_lock);
+	inode->dir_hints = NULL;
+	lock_init(&inode->cursor_lock);
+	inode->cursor_clst = 0;
+	memset(inode->skip, 0, sizeof inode->skip);
+	inode->overflow = NULL;
+	lock_release(&open_inodes_lock);
+
+	success = inode_load(inode);
+
+	lock_acquire(&open_inodes_lock);
+	inode->loading = false;
+	cond_broadcast(&inode->loaded, &open_inodes_lock);
+	if (!success)
+	{
+		hash_delete(&open_inodes, &inode->elem);
+		inode->load_failed = true;
+		inode_drop_failed(inode);
+		inode = NULL;
+	}
+	lock_release(&open_inodes_lock);
 	return inode;
 }
 
@@ -169,7 +514,11 @@ struct inode *
 inode_reopen(struct inode *inode)
 {
 	if (inode != NULL)
+	{
+		lock_acquire(&open_inodes_lock);
 		inode->open_cnt++;
+		lock_release(&open_inodes_lock);
+	}
 	return inode;
 }
 
@@ -190,20 +539,32 @@ void inode_close(struct inode *inode)
 		return;
 
 	/* Release resources if this was the last opener. */
+	lock_acquire(&open_inodes_lock);
 	if (--inode->open_cnt == 0)
 	{
-		/* Remove from inode list and release lock. */
-		list_remove(&inode->elem);
+		/* Remove from inode table and release lock. */
+		hash_delete(&open_inodes, &inode->elem);
+		lock_release(&open_inodes_lock);
 
 		/* Deallocate blocks if removed. */
 		if (inode->removed)
 		{
+			/* No handle is left to re-insert entries keyed by
+			 * this sector, so it is safe to forget them now. */
+			if (inode->data.is_dir)
+				dcache_purge_dir(inode->sector);
 			fat_remove_chain(sector_to_cluster(inode->sector), 0);
 			fat_remove_chain(sector_to_cluster(inode->data.start), 0);
+			if (inode->data.overflow != 0)
+				fat_remove_chain(inode->data.overflow, 0);
 		}
 
+		free(inode->overflow);
+		free(inode->dir_hints);
 		free(inode);
 	}
+	else
+		lock_release(&open_inodes_lock);
 }
 
 int is_inode_dir(struct inode *inode)
@@ -215,7 +576,43 @@ int is_inode_dir(struct inode *inode)
 void inode_remove(struct inode *inode)
 {
 	ASSERT(inode != NULL);
+	lock_acquire(&open_inodes_lock);
 	inode->removed = true;
+	lock_release(&open_inodes_lock);
+}
+
+/* Locks the entries of directory INODE exclusively, for changing
+ * them. */
+void inode_dir_lock(struct inode *inode)
+{
+	rwlock_acquire_write(&inode->dir_lock);
+}
+
+/* Locks the entries of directory INODE shared, for lookups.  Any
+ * number of lookups may run together, but not alongside a change. */
+void inode_dir_lock_shared(struct inode *inode)
+{
+	rwlock_acquire_read(&inode->dir_lock);
+}
+
+/* Releases either kind of lock on directory INODE. */
+void inode_dir_unlock(struct inode *inode)
+{
+	rwlock_release(&inode->dir_lock);
+}
+
+/* Returns CNT words that the directory code keeps with directory
+ * INODE while it is open, zeroed when first asked for, or a null
+ * pointer if memory is short.  CNT must not change between calls.
+ * The caller must hold the directory lock exclusively. */
+uint32_t *
+inode_dir_hints(struct inode *inode, size_t cnt)
+{
+	ASSERT(inode->dir_lock.writer == thread_current());
+
+	if (inode->dir_hints == NULL)
+		inode->dir_hints = calloc(cnt, sizeof *inode->dir_hints);
+	return inode->dir_hints;
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
@@ -225,22 +622,26 @@ off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset
 {
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
+
+	rwlock_acquire_read(&inode->rwlock);
 	if (inode->data.length < size + offset)
 		size = inode->data.length - offset;
 	else if (inode->data.length < offset)
-		return 0;
+		size = 0;
 	while (size > 0)
 	{
 		/* Disk sector to read, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector(inode, offset);
 		if (sector_idx == EOChain)
-			return 0;
+		{
+			bytes_read = 0;
+			break;
+		}
 
 		int sector_ofs = offset % DISK_SECTOR_SIZE;
 
 		/* Bytes left in inode, bytes left in sector, lesser of the two. */
-		off_t inode_left = inode_length(inode) - offset;
+		off_t inode_left = inode->data.length - offset;
 		int sector_left = DISK_SECTOR_SIZE - sector_ofs;
 		int min_left = inode_left < sector_left ? inode_left : sector_left;
 
@@ -249,35 +650,60 @@ off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE)
-		{
-			/* Read full sector directly into caller's buffer. */
-			disk_read(filesys_disk, sector_idx, buffer + bytes_read);
-		}
-		else
+		/* On entering a cluster, bring the sectors of it that the
+		 * read covers into the cache with one transfer, so that
+		 * misses are not read from disk a sector at a time. */
+		if (bytes_read == 0 || offset % CLUSTER_SIZE == 0)
 		{
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL)
-			{
-				bounce = malloc(DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read(filesys_disk, sector_idx, bounce);
-			memcpy(buffer + bytes_read, bounce + sector_ofs, chunk_size);
+			off_t run_end = offset - offset % CLUSTER_SIZE + CLUSTER_SIZE;
+			size_t run;
+
+			if (run_end > offset + size)
+				run_end = offset + size;
+			run = DIV_ROUND_UP(run_end, DISK_SECTOR_SIZE) - offset / DISK_SECTOR_SIZE;
+			if (run > 1)
+				buffer_cache_prefetch_multi(sector_idx, run);
 		}
 
+		/* Copy out of the buffer cache, which reads the sector from
+		 * disk only on a miss. */
+		buffer_cache_read(sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
+
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free(bounce);
+	rwlock_release(&inode->rwlock);
 
 	return bytes_read;
 }
 
+/* Queues the sectors holding LENGTH bytes at OFFSET in INODE to be
+ * read into the buffer cache in the background.  Stops at end of
+ * file. */
+void inode_readahead(struct inode *inode, off_t offset, off_t length)
+{
+	off_t end;
+
+	rwlock_acquire_read(&inode->rwlock);
+	end = offset + length < inode->data.length ? offset + length : inode->data.length;
+	offset -= offset % DISK_SECTOR_SIZE;
+	while (offset < end)
+	{
+		/* One FAT walk per cluster; its sectors are contiguous. */
+		disk_sector_t sector_idx = byte_to_sector(inode, offset);
+		if (sector_idx == EOChain)
+			break;
+		do
+		{
+			buffer_cache_readahead(sector_idx++);
+			offset += DISK_SECTOR_SIZE;
+		} while (offset < end && offset % CLUSTER_SIZE != 0);
+	}
+	rwlock_release(&inode->rwlock);
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
  * less than SIZE if end of file is reached or an error occurs.
@@ -288,29 +714,23 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
 {
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
-	uint8_t *bounce = NULL;
 
+	rwlock_acquire_write(&inode->rwlock);
 	if (inode->deny_write_cnt)
+	{
+		rwlock_release(&inode->rwlock);
 		return 0;
+	}
 
-	size_t left_size = DISK_SECTOR_SIZE * SECTORS_PER_CLUSTER - inode->data.length % (DISK_SECTOR_SIZE * SECTORS_PER_CLUSTER);
-	size_t need_size = 0;
 	if (inode->data.length < offset + size)
 	{
-		need_size = offset + size - inode->data.length;
-		inode->data.length += need_size;
-	}
-	if (need_size > left_size)
-	{
-		need_size -= left_size;
-		cluster_t last_clst = sector_to_cluster(byte_to_sector(inode, inode->data.length - 1));
-		if (inode->data.length == 0)
-			last_clst = sector_to_cluster(inode->data.start);
-		for (int i = 0; i < need_size / (DISK_SECTOR_SIZE * SECTORS_PER_CLUSTER) + 1; i++)
+		if (!inode_extend(inode, DIV_ROUND_UP(offset + size, CLUSTER_SIZE)))
 		{
-			last_clst = fat_create_chain(last_clst);
+			rwlock_release(&inode->rwlock);
+			return 0;
 		}
-		disk_write(filesys_disk, inode->sector, inode);
+		inode->data.length = offset + size;
+		buffer_cache_write(inode->sector, &inode->data, 0, DISK_SECTOR_SIZE); // on-disk inode도 갱신
 	}
 	while (size > 0)
 	{
@@ -324,38 +744,16 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
 		/* Number of bytes to actually write into this sector. */
 		int chunk_size = sector_left < size ? sector_left : size;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE)
-		{
-			/* Write full sector directly to disk. */
-			disk_write(filesys_disk, sector_idx, buffer + bytes_written);
-		}
-		else
-		{
-			/* We need a bounce buffer. */
-			if (bounce == NULL)
-			{
-				bounce = malloc(DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left)
-				disk_read(filesys_disk, sector_idx, bounce);
-			else
-				memset(bounce, 0, DISK_SECTOR_SIZE);
-			memcpy(bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write(filesys_disk, sector_idx, bounce);
-		}
+		/* Write into the buffer cache.  A partial sector is read in
+		 * first on a miss; the disk is updated on write-back. */
+		buffer_cache_write(sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free(bounce);
+	rwlock_release(&inode->rwlock);
 
 	return bytes_written;
 }
@@ -364,8 +762,10 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
    May be called at most once per inode opener. */
 void inode_deny_write(struct inode *inode)
 {
+	rwlock_acquire_write(&inode->rwlock);
 	inode->deny_write_cnt++;
 	ASSERT(inode->deny_write_cnt <= inode->open_cnt);
+	rwlock_release(&inode->rwlock);
 }
 
 /* Re-enables writes to INODE.
@@ -373,12 +773,15 @@ void inode_deny_write(struct inode *inode)
  * inode_deny_write() on the inode, before closing the inode. */
 void inode_allow_write(struct inode *inode)
 {
+	rwlock_acquire_write(&inode->rwlock);
 	ASSERT(inode->deny_write_cnt > 0);
 	ASSERT(inode->deny_write_cnt <= inode->open_cnt);
 	inode->deny_write_cnt--;
+	rwlock_release(&inode->rwlock);
 }
 
-/* Returns the length, in bytes, of INODE's data. */
+/* Returns the length, in bytes, of INODE's data.  The length is a
+ * single word, so it is read without taking INODE's rwlock. */
 off_t inode_length(const struct inode *inode)
 {
 	return inode->data.length;
@@ -1,9 +1,22 @@
 /* page_cache.c: Implementation of Page Cache (Buffer Cache). */
 
 #include "vm/vm.h"
+#include <debug.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/fat.h"
+#include "filesys/filesys.h"
+#include "filesys/page_cache.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 static bool page_cache_readahead(struct page *page, void *kva);
 static bool page_cache_writeback(struct page *page);
 static void page_cache_destroy(struct page *page);
+static void page_cache_kworkerd(void *aux);
+static void page_cache_readaheadd(void *aux);
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations page_cache_op = {
@@ -15,39 +28,445 @@ static const struct page_operations page_cache_op = {
 
 tid_t page_cache_workerd;
 
-/* The initializer of file vm */
+/* Ticks between two flushes by page_cache_kworkerd, as the
+ * traditional update daemon does. */
+#define FLUSH_INTERVAL (30 * TIMER_FREQ)
+
+/* One cached sector.
+ * SECTOR, IN_USE, ACCESSED and PIN_CNT are guarded by cache_lock.
+ * DATA and DIRTY are guarded by LOCK while the entry is pinned; an
+ * unpinned entry is never locked, so cache_lock covers them then. */
+struct cache_entry
+{
+	disk_sector_t sector; /* Cached sector. */
+	bool in_use;		  /* Holds a sector? */
+	bool dirty;			  /* Newer than the copy on disk? */
+	bool accessed;		  /* Used since the clock hand last passed? */
+	int pin_cnt;		  /* Threads that need it to stay put. */
+	struct lock lock;	  /* Held while DATA is filled, read or written. */
+	uint8_t *data;		  /* DISK_SECTOR_SIZE bytes. */
+};
+
+static struct cache_entry cache[BUFFER_CACHE_SIZE];
+static struct lock cache_lock;
+static struct condition cache_unpinned; /* Signaled when an entry's pin_cnt drops to 0. */
+static size_t clock_hand; /* Next entry the clock looks at. */
+
+/* Sectors waiting to be read ahead by page_cache_readaheadd.  When
+ * the ring is full, new requests are dropped: read-ahead is only a
+ * hint. */
+#define READAHEAD_QUEUE_SIZE 64
+static disk_sector_t ra_queue[READAHEAD_QUEUE_SIZE];
+static size_t ra_head;			/* Next sector to read. */
+static size_t ra_cnt;			/* Sectors in the ring. */
+static struct lock ra_lock;		/* Guards the ring. */
+static struct semaphore ra_sema; /* Counts sectors in the ring. */
+
+/* Most queued sectors read ahead by one disk command. */
+#define RA_RUN_MAX (PGSIZE / DISK_SECTOR_SIZE)
+
+/* The initializer of file vm.  Starts the flush and read-ahead
+ * daemons of the buffer cache.  filesys_init() calls it in every
+ * build with a file system, and vm_init() calls it again under
+ * EFILESYS, so later calls do nothing. */
 void pagecache_init(void)
 {
 	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
+	if (page_cache_workerd != 0)
+		return;
+	page_cache_workerd = thread_create("kworkerd", PRI_DEFAULT, page_cache_kworkerd, NULL);
+	if (page_cache_workerd == TID_ERROR)
+		PANIC("page cache worker creation failed");
+	if (thread_create("kreadaheadd", PRI_DEFAULT, page_cache_readaheadd, NULL) == TID_ERROR)
+		PANIC("page cache read-ahead worker creation failed");
 }
 
 /* Initialize the page cache */
-bool page_cache_initializer(struct page *page, enum vm_type type, void *kva)
+bool page_cache_initializer(struct page *page, enum vm_type type UNUSED, void *kva UNUSED)
 {
 	/* Set up the handler */
 	page->operations = &page_cache_op;
+	return true;
 }
 
 /* Utilze the Swap in mechanism to implement readhead */
 static bool
-page_cache_readahead(struct page *page, void *kva)
+page_cache_readahead(struct page *page UNUSED, void *kva UNUSED)
 {
+	/* File data is cached per sector by the buffer cache below, so no
+	 * page is ever of this type. */
+	return false;
 }
 
 /* Utilze the Swap out mechanism to implement writeback */
 static bool
-page_cache_writeback(struct page *page)
+page_cache_writeback(struct page *page UNUSED)
 {
+	return false;
 }
 
 /* Destory the page_cache. */
 static void
-page_cache_destroy(struct page *page)
+page_cache_destroy(struct page *page UNUSED)
 {
 }
 
 /* Worker thread for page cache */
 static void
-page_cache_kworkerd(void *aux)
+page_cache_kworkerd(void *aux UNUSED)
+{
+	while (true)
+	{
+		timer_sleep(FLUSH_INTERVAL);
+#ifdef EFILESYS
+		fat_flush(); // buffer cache를 먼저 기록한 뒤 FAT를 기록
+#else
+		buffer_cache_flush();
+#endif
+	}
+}
+
+/* Read-ahead thread: fills the cache with queued sectors so that
+ * the reader that asked for them finds them there. */
+static void
+page_cache_readaheadd(void *aux UNUSED)
+{
+	while (true)
+	{
+		disk_sector_t sector;
+		size_t cnt = 1;
+
+		sema_down(&ra_sema);
+		lock_acquire(&ra_lock);
+		sector = ra_queue[ra_head];
+		ra_head = (ra_head + 1) % READAHEAD_QUEUE_SIZE;
+		ra_cnt--;
+
+		/* Take the queued sectors that continue the run as well, so
+		 * that they are read with one command. */
+		while (cnt < RA_RUN_MAX && ra_cnt > 0 && ra_queue[ra_head] == sector + cnt
+			   && sema_try_down(&ra_sema))
+		{
+			ra_head = (ra_head + 1) % READAHEAD_QUEUE_SIZE;
+			ra_cnt--;
+			cnt++;
+		}
+		lock_release(&ra_lock);
+
+		buffer_cache_prefetch_multi(sector, cnt);
+	}
+}
+
+/* Initializes the buffer cache.  Must run before the file system
+ * touches the disk. */
+void buffer_cache_init(void)
+{
+	uint8_t *data = palloc_get_multiple(PAL_ASSERT,
+										BUFFER_CACHE_SIZE * DISK_SECTOR_SIZE / PGSIZE);
+
+	lock_init(&cache_lock);
+	cond_init(&cache_unpinned);
+	for (int i = 0; i < BUFFER_CACHE_SIZE; i++)
+	{
+		cache[i].in_use = false;
+		cache[i].dirty = false;
+		cache[i].accessed = false;
+		cache[i].pin_cnt = 0;
+		lock_init(&cache[i].lock);
+		cache[i].data = data + i * DISK_SECTOR_SIZE;
+	}
+	clock_hand = 0;
+
+	lock_init(&ra_lock);
+	sema_init(&ra_sema, 0);
+	ra_head = ra_cnt = 0;
+}
+
+/* Returns the entry caching SECTOR, or NULL.  cache_lock must be
+ * held. */
+static struct cache_entry *
+cache_lookup(disk_sector_t sector)
+{
+	for (int i = 0; i < BUFFER_CACHE_SIZE; i++)
+		if (cache[i].in_use && cache[i].sector == sector)
+			return &cache[i];
+	return NULL;
+}
+
+/* Picks an unpinned entry with the clock algorithm and returns it
+ * free.  cache_lock must be held.  It is dropped while a dirty
+ * victim is written back and while waiting for an entry to be
+ * unpinned when every entry is pinned, so the caller must look its
+ * sector up again before claiming the entry. */
+static struct cache_entry *
+cache_evict(void)
+{
+	int scanned = 0;
+
+	while (true)
+	{
+		struct cache_entry *e = &cache[clock_hand];
+		clock_hand = (clock_hand + 1) % BUFFER_CACHE_SIZE;
+
+		if (e->pin_cnt == 0)
+		{
+			if (!e->in_use)
+				return e;
+			if (e->accessed)
+				e->accessed = false; // second chance
+			else
+			{
+				/* Write the victim back without cache_lock.  The pin
+				 * marks it as being written, so other evictors pass
+				 * it by, and a lookup of its sector waits on E's lock
+				 * instead of missing and reading it stale. */
+				if (e->dirty)
+				{
+					e->pin_cnt++;
+					lock_acquire(&e->lock); // 고정되지 않은 항목이었으므로 바로 얻는다
+					lock_release(&cache_lock);
+					disk_write(filesys_disk, e->sector, e->data);
+					e->dirty = false;
+					lock_release(&e->lock);
+					lock_acquire(&cache_lock);
+					if (--e->pin_cnt == 0)
+						cond_signal(&cache_unpinned, &cache_lock);
+					scanned = 0; // lock을 놓은 사이에 풀린 항목이 있을 수 있다
+				}
+				/* Reuse it unless it was touched during the write. */
+				if (e->pin_cnt == 0 && !e->accessed && !e->dirty)
+				{
+					e->in_use = false;
+					return e;
+				}
+			}
+		}
+
+		/* Every entry is pinned.  Sleep rather than yield: a yield
+		 * never runs pin holders of lower priority. */
+		if (++scanned == 2 * BUFFER_CACHE_SIZE)
+		{
+			cond_wait(&cache_unpinned, &cache_lock);
+			scanned = 0;
+		}
+	}
+}
+
+/* Returns the entry for SECTOR, pinned and locked.  On a miss the
+ * sector is read from disk only if READ is true; otherwise the
+ * caller is about to overwrite all of it. */
+static struct cache_entry *
+cache_acquire(disk_sector_t sector, bool read)
+{
+	struct cache_entry *e;
+
+	lock_acquire(&cache_lock);
+	e = cache_lookup(sector);
+	if (e == NULL)
+	{
+		struct cache_entry *victim = cache_evict();
+
+		e = cache_lookup(sector); // 비우는 동안 다른 스레드가 읽어 왔을 수 있다
+		if (e == NULL)
+		{
+			e = victim;
+			e->sector = sector;
+			e->in_use = true;
+			e->accessed = true;
+			e->pin_cnt = 1;
+			lock_acquire(&e->lock); // 고정되지 않은 항목이었으므로 바로 얻는다
+			lock_release(&cache_lock);
+
+			if (read)
+				disk_read(filesys_disk, sector, e->data);
+			return e;
+		}
+	}
+
+	e->pin_cnt++;
+	e->accessed = true;
+	lock_release(&cache_lock);
+	lock_acquire(&e->lock); // 다른 스레드가 채우거나 기록하는 중이면 기다린다
+	return e;
+}
+
+/* Unlocks and unpins E, which becomes dirty if DIRTY is true. */
+static void
+cache_release(struct cache_entry *e, bool dirty)
+{
+	if (dirty)
+		e->dirty = true;
+	lock_release(&e->lock);
+
+	lock_acquire(&cache_lock);
+	if (--e->pin_cnt == 0)
+		cond_signal(&cache_unpinned, &cache_lock);
+	lock_release(&cache_lock);
+}
+
+/* Copies SIZE bytes at SECTOR_OFS in SECTOR into BUFFER. */
+void buffer_cache_read(disk_sector_t sector, void *buffer, int sector_ofs, int size)
+{
+	struct cache_entry *e;
+
+	ASSERT(sector_ofs >= 0 && size >= 0 && sector_ofs + size <= DISK_SECTOR_SIZE);
+
+	e = cache_acquire(sector, true);
+	memcpy(buffer, e->data + sector_ofs, size);
+	cache_release(e, false);
+}
+
+/* Copies SIZE bytes from BUFFER to SECTOR_OFS in SECTOR.  The disk
+ * is written later, on eviction or by buffer_cache_flush(). */
+void buffer_cache_write(disk_sector_t sector, const void *buffer, int sector_ofs, int size)
+{
+	struct cache_entry *e;
+
+	ASSERT(sector_ofs >= 0 && size >= 0 && sector_ofs + size <= DISK_SECTOR_SIZE);
+
+	e = cache_acquire(sector, size != DISK_SECTOR_SIZE);
+	memcpy(e->data + sector_ofs, buffer, size);
+	cache_release(e, true);
+}
+
+/* Writes every dirty entry back to disk.  All the writes are
+ * queued before any is waited for, so that the disk can merge
+ * adjacent sectors and serve them in elevator order. */
+void buffer_cache_flush(void)
+{
+	struct disk_request *reqs = malloc(BUFFER_CACHE_SIZE * sizeof *reqs);
+	struct cache_entry *held[BUFFER_CACHE_SIZE];
+	size_t cnt = 0;
+
+	for (int i = 0; i < BUFFER_CACHE_SIZE; i++)
+	{
+		struct cache_entry *e = &cache[i];
+
+		lock_acquire(&cache_lock);
+		if (!e->in_use || !e->dirty)
+		{
+			lock_release(&cache_lock);
+			continue;
+		}
+		e->pin_cnt++;
+		lock_release(&cache_lock);
+
+		lock_acquire(&e->lock);
+		if (!e->dirty)
+			cache_release(e, false);
+		else if (reqs == NULL) // 메모리가 없으면 하나씩 기록
+		{
+			disk_write(filesys_disk, e->sector, e->data);
+			e->dirty = false;
+			cache_release(e, false);
+		}
+		else
+		{
+			disk_request_init(&reqs[cnt], filesys_disk, e->sector, e->data, 1, true);
+			disk_submit(&reqs[cnt]);
+			held[cnt++] = e;
+		}
+	}
+
+	for (size_t i = 0; i < cnt; i++)
+	{
+		disk_wait(&reqs[i]);
+		held[i]->dirty = false;
+		cache_release(held[i], false);
+	}
+	free(reqs);
+}
+
+/* Reads SECTOR into the cache, unless it is there already. */
+void buffer_cache_prefetch(disk_sector_t sector)
+{
+	lock_acquire(&cache_lock);
+	if (cache_lookup(sector) != NULL)
+	{
+		lock_release(&cache_lock);
+		return;
+	}
+	lock_release(&cache_lock);
+
+	cache_release(cache_acquire(sector, true), false);
+}
+
+/* Reads the CNT sectors starting at SECTOR into the cache, those
+ * that are not there already, with a single disk transfer.  CNT
+ * must not exceed RA_RUN_MAX. */
+void buffer_cache_prefetch_multi(disk_sector_t sector, size_t cnt)
+{
+	struct cache_entry *claimed[RA_RUN_MAX];
+	size_t first = cnt, last = 0;
+	uint8_t *bounce;
+
+	ASSERT(cnt <= RA_RUN_MAX);
+	if (cnt == 1)
+	{
+		buffer_cache_prefetch(sector);
+		return;
+	}
+
+	/* Claim an entry for every missing sector, as cache_acquire()
+	 * does on a miss, but leave the disk read for later. */
+	lock_acquire(&cache_lock);
+	for (size_t i = 0; i < cnt; i++)
+	{
+		struct cache_entry *e = cache_lookup(sector + i);
+
+		claimed[i] = NULL;
+		if (e != NULL)
+			continue;
+		e = cache_evict();
+		if (cache_lookup(sector + i) != NULL) // 비우는 동안 읽혀 왔다
+			continue;
+		e->sector = sector + i;
+		e->in_use = true;
+		e->accessed = true;
+		e->pin_cnt = 1;
+		lock_acquire(&e->lock);
+		claimed[i] = e;
+		if (first == cnt)
+			first = i;
+		last = i;
+	}
+	lock_release(&cache_lock);
+	if (first == cnt)
+		return;
+
+	/* Sectors in between that were cached already are read again
+	 * and ignored, which is cheaper than another command. */
+	bounce = palloc_get_page(0);
+	if (bounce == NULL)
+	{
+		for (size_t i = first; i <= last; i++)
+			if (claimed[i] != NULL)
+				disk_read(filesys_disk, sector + i, claimed[i]->data);
+	}
+	else
+	{
+		disk_read_multi(filesys_disk, sector + first, bounce, last - first + 1);
+		for (size_t i = first; i <= last; i++)
+			if (claimed[i] != NULL)
+				memcpy(claimed[i]->data, bounce + (i - first) * DISK_SECTOR_SIZE, DISK_SECTOR_SIZE);
+		palloc_free_page(bounce);
+	}
+	for (size_t i = first; i <= last; i++)
+		if (claimed[i] != NULL)
+			cache_release(claimed[i], false);
+}
+
+/* Queues SECTOR to be read into the cache in the background. */
+void buffer_cache_readahead(disk_sector_t sector)
 {
+	lock_acquire(&ra_lock);
+	if (ra_cnt == READAHEAD_QUEUE_SIZE)
+	{
+		lock_release(&ra_lock);
+		return;
+	}
+	ra_queue[(ra_head + ra_cnt) % READAHEAD_QUEUE_SIZE] = sector;
+	ra_cnt++;
+	lock_release(&ra_lock);
+	sema_up(&ra_sema);
 }
@@ -2,7 +2,11 @@
 #define DEVICES_DISK_H
 
 #include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "threads/synch.h"
 
 /* Size of a disk sector in bytes. */
 #define DISK_SECTOR_SIZE 512
@@ -15,6 +19,29 @@ typedef uint32_t disk_sector_t;
  * printf ("sector=%"PRDSNu"\n", sector); */
 #define PRDSNu PRIu32
 
+/* Most sectors in one request. */
+#define DISK_REQUEST_MAX 64
+
+/* An asynchronous disk request. */
+struct disk_request
+{
+	struct disk *disk;	  /* Disk to transfer to or from. */
+	disk_sector_t sector; /* First sector. */
+	size_t cnt;			  /* Number of sectors. */
+	void *buffer;		  /* CNT * DISK_SECTOR_SIZE bytes. */
+	bool write;			  /* Write to disk? Otherwise read. */
+
+	/* Called from the interrupt handler when the request is done,
+	   if non-null; must not sleep. */
+	void (*complete)(struct disk_request *);
+	void *aux; /* For COMPLETE's use. */
+
+	/* Owned by devices/disk.c. */
+	int64_t deadline;		/* Tick by which to serve it. */
+	struct semaphore done;	/* Up'd when done. */
+	struct list_elem elem;	/* Channel queue element. */
+};
+
 void disk_init(void);
 void disk_print_stats(void);
 
@@ -22,6 +49,14 @@ struct disk *disk_get(int chan_no, int dev_no);
 disk_sector_t disk_size(struct disk *);
 void disk_read(struct disk *, disk_sector_t, void *);
 void disk_write(struct disk *, disk_sector_t, const void *);
+void disk_read_multi(struct disk *, disk_sector_t, void *, size_t cnt);
+void disk_write_multi(struct disk *, disk_sector_t, const void *, size_t cnt);
+
+void disk_request_init(struct disk_request *, struct disk *, disk_sector_t,
+					   void *buffer, size_t cnt, bool write);
+void disk_submit(struct disk_request *);
+void disk_submit_batch(struct disk_request *, size_t cnt);
+void disk_wait(struct disk_request *);
 
 void register_disk_inspect_intr();
 #endif /* devices/disk.h */
@@ -0,0 +1,22 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+#include <stdbool.h>
+#include "devices/disk.h"
+
+/* Result of a dentry cache lookup. */
+enum dcache_result
+{
+	DCACHE_MISS,	 /* Nothing cached; ask the directory. */
+	DCACHE_HIT,		 /* Name exists; its inode sector is returned. */
+	DCACHE_NEGATIVE, /* Name is known not to exist. */
+};
+
+/* Dentry cache: (parent directory sector, name) -> inode sector. */
+void dcache_init (void);
+enum dcache_result dcache_lookup (disk_sector_t parent, const char *name,
+		disk_sector_t *sector);
+void dcache_insert (disk_sector_t parent, const char *name, bool exists,
+		disk_sector_t sector);
+void dcache_invalidate (disk_sector_t parent, const char *name);
+void dcache_purge_dir (disk_sector_t parent);
+#endif
@@ -21,12 +21,18 @@ typedef uint32_t cluster_t; /* Index of a cluster within FAT. */
 void fat_init(void);
 void fat_open(void);
 void fat_close(void);
-void fat_create(void);
+void fat_create(bool extents);
 void fat_close(void);
+void fat_flush(void);
+bool fat_extents_enabled(void);
 
 cluster_t fat_create_chain(
     cluster_t clst /* Cluster # to stretch, 0: Create a new chain */
 );
+cluster_t fat_create_chain_multi(
+    cluster_t clst, /* Cluster # to stretch, 0: Create a new chain */
+    size_t cnt      /* Number of clusters to add */
+);
 void fat_remove_chain(
     cluster_t clst, /* Cluster # to be removed */
     cluster_t pclst /* Previous cluster of clst, 0: clst is the start of chain */
@@ -34,5 +40,6 @@ void fat_remove_chain(
 cluster_t fat_get(cluster_t clst);
 void fat_put(cluster_t clst, cluster_t val);
 disk_sector_t cluster_to_sector(cluster_t clst);
+cluster_t sector_to_cluster(disk_sector_t sec_no);
 
 #endif /* filesys/fat.h */
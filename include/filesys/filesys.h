@@ -11,6 +11,9 @@
 /* Disk used for file system. */
 extern struct disk *filesys_disk;
 
+/* If true, do_format() lays new files out as extents. */
+extern bool filesys_format_extents;
+
 void filesys_init (bool format);
 void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
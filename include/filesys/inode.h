@@ -2,6 +2,8 @@
 #define FILESYS_INODE_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "filesys/off_t.h"
 #include "devices/disk.h"
 
@@ -14,7 +16,12 @@ struct inode *inode_reopen(struct inode *);
 disk_sector_t inode_get_inumber(const struct inode *);
 void inode_close(struct inode *);
 void inode_remove(struct inode *);
+void inode_dir_lock(struct inode *);
+void inode_dir_lock_shared(struct inode *);
+void inode_dir_unlock(struct inode *);
+uint32_t *inode_dir_hints(struct inode *, size_t cnt);
 off_t inode_read_at(struct inode *, void *, off_t size, off_t offset);
+void inode_readahead(struct inode *, off_t offset, off_t length);
 off_t inode_write_at(struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write(struct inode *);
 void inode_allow_write(struct inode *);
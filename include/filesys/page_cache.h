@@ -1,12 +1,25 @@
 #ifndef FILESYS_PAGE_CACHE_H
 #define FILESYS_PAGE_CACHE_H
-#include "vm/vm.h"
+#include <stdbool.h>
+#include "devices/disk.h"
 
 struct page;
 enum vm_type;
 
 struct page_cache {};
 
-void page_cache_init (void);
+void pagecache_init (void);
 bool page_cache_initializer (struct page *page, enum vm_type type, void *kva);
+
+/* Number of sectors held by the buffer cache. */
+#define BUFFER_CACHE_SIZE 64
+
+/* Sector buffer cache shared by every file system access. */
+void buffer_cache_init (void);
+void buffer_cache_read (disk_sector_t, void *, int sector_ofs, int size);
+void buffer_cache_write (disk_sector_t, const void *, int sector_ofs, int size);
+void buffer_cache_flush (void);
+void buffer_cache_prefetch (disk_sector_t);
+void buffer_cache_prefetch_multi (disk_sector_t, size_t cnt);
+void buffer_cache_readahead (disk_sector_t);
 #endif
@@ -16,18 +16,63 @@ bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
+/* Acquisition statistics of an adaptive lock. */
+struct lock_stats {
+	const char *name;           /* Name of the lock. */
+	unsigned acquire_cnt;       /* # of acquisitions. */
+	unsigned contend_cnt;       /* # of acquisitions that found it held. */
+	unsigned retry_cnt;         /* # of those resolved by yielding. */
+	struct lock_stats *next;    /* Next in list of adaptive locks. */
+};
+
 /* Lock. */
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	struct lock_stats *stats;   /* Adaptive locks only, else NULL. */
 };
 
 void lock_init (struct lock *);
+void lock_init_adaptive (struct lock *, struct lock_stats *, const char *name);
+void lock_print_stats (void);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Readers-writer lock.  Any number of readers or a single writer
+   may hold it.  Writers are preferred: once a writer is waiting,
+   new readers queue behind it.  A thread that blocks on an rwlock
+   donates its priority to every current holder. */
+struct rwlock {
+	unsigned readers;           /* # of threads holding it shared. */
+	struct thread *writer;      /* Thread holding it exclusively. */
+	struct list read_waiters;   /* Threads waiting for shared access. */
+	struct list write_waiters;  /* Threads waiting for exclusive access. */
+	struct list holders;        /* rw_hold of each current holder. */
+};
+
+/* One thread's hold on an rwlock.  Each thread has RW_HOLD_MAX of
+   these, so that holders can be found for priority donation.  No
+   thread may hold more than RW_HOLD_MAX rwlocks at once, which
+   rwlock_acquire_read() and rwlock_acquire_write() assert.  The
+   deepest nesting in the kernel is three: an inode's rwlock, the
+   spt_lock taken by a page fault on the user buffer being copied,
+   and the rwlock of the file that fault reads in. */
+struct rw_hold {
+	struct rwlock *rwlock;      /* Held rwlock, or NULL if unused. */
+	struct thread *thread;      /* Holding thread. */
+	struct list_elem elem;      /* Element in rwlock's holders. */
+};
+#define RW_HOLD_MAX 4
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
+int rwlock_waiter_priority (const struct thread *);
+
 /* Condition variable. */
 struct condition {
 	struct list waiters;        /* List of waiting threads. */
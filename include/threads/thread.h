@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/fixed-point.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
@@ -29,6 +30,11 @@ typedef int tid_t;
 #define PRI_DEFAULT 31 /* Default priority. */
 #define PRI_MAX 63	   /* Highest priority. */
 
+/* Thread niceness, for the advanced scheduler. */
+#define NICE_MIN -20	 /* Nicest. */
+#define NICE_DEFAULT 0 /* Default niceness. */
+#define NICE_MAX 20	 /* Least nice. */
+
 #define FDT_COUNT 128
 #define FDT_PAGE_COUNT 3
 
@@ -97,6 +103,13 @@ struct thread
 	char name[16];			   /* Name (for debugging purposes). */
 	int priority;			   /* Priority. */
 	int64_t wakeup_ticks;	   // 깨어날 tick
+	struct list_elem all_elem; /* List element for all threads list. */
+
+	/* Used by the advanced scheduler (thread.c). */
+	int nice;					 /* Niceness. */
+	fixed_t recent_cpu;			 /* Recent CPU usage. */
+	bool cpu_dirty;				 /* On dirty_list: recent_cpu changed. */
+	struct list_elem dirty_elem; /* List element for dirty_list. */
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem; /* List element. */
@@ -105,6 +118,8 @@ struct thread
 	struct lock *wait_on_lock;
 	struct list donations;
 	struct list_elem donation_elem;
+	struct rwlock *wait_on_rwlock;			/* rwlock we are blocked on. */
+	struct rw_hold rw_holds[RW_HOLD_MAX]; /* rwlocks we hold. */
 
 	struct intr_frame parent_if;
 	uint64_t user_rsp;
@@ -163,10 +178,10 @@ void thread_exit(void) NO_RETURN;
 void thread_yield(void);
 void thread_sleep(int64_t ticks);
 void thread_wakeup(int64_t current_ticks);
-bool cmp_thread_ticks(const struct list_elem *a, const struct list_elem *b, void *aux);
 
 int thread_get_priority(void);
 void thread_set_priority(int);
+void thread_change_priority(struct thread *, int priority);
 bool cmp_thread_priority(const struct list_elem *a, const struct list_elem *b, void *aux);
 bool cmp_sema_priority(const struct list_elem *a, const struct list_elem *b, void *aux);
 void preempt_priority(void);
@@ -183,7 +198,6 @@ int thread_get_load_avg(void);
 
 void do_iret(struct intr_frame *tf);
 
-bool cmp_thread_ticks(const struct list_elem *a, const struct list_elem *b, void *aux);
 bool cmp_thread_priority(const struct list_elem *a, const struct list_elem *b, void *aux);
 
 #endif /* threads/thread.h */
@@ -1,10 +1,17 @@
 #ifndef VM_ANON_H
 #define VM_ANON_H
 #include "vm/vm.h"
+#include <stdint.h>
 #include "devices/disk.h"
 
 #define SLOT_SIZE 8
 
+// 한 번에 쫓아내거나 미리 읽어 들이는 최대 페이지 수
+#define SWAP_CLUSTER 8
+
+// 스왑 슬롯에 있지 않은 페이지의 슬롯 번호
+#define SWAP_SLOT_NONE SIZE_MAX
+
 struct page;
 enum vm_type;
 
@@ -13,18 +20,15 @@ struct lock swap_lock;
 struct anon_page
 {
     void *aux;
-    struct swap_slot *slot;
-    // 디스크로 쫓겨난 위치 정보
-};
-
-struct swap_slot
-{
-    disk_sector_t start_sector;
-    struct list page_list;
-    struct list_elem slot_elem;
+    size_t slot;
+    // 디스크로 쫓겨난 슬롯 번호. 같은 슬롯을 쓰는 페이지들은
+    // out_elem으로 머리 없는 고리를 이룬다
 };
 
 void vm_anon_init(void);
 bool anon_initializer(struct page *page, enum vm_type type, void *kva);
+void anon_swap_out_cluster(struct page **pages, size_t cnt);
+void anon_swap_out_submit(struct page **pages, size_t cnt, struct disk_request *reqs);
+void anon_share_slot(struct page *page, struct page *newpage);
 
 #endif
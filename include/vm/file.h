@@ -4,6 +4,7 @@
 #include "vm/vm.h"
 
 struct page;
+struct frame;
 enum vm_type;
 
 struct file_page
@@ -27,6 +28,8 @@ struct file_load
 
 void vm_file_init(void);
 bool file_backed_initializer(struct page *page, enum vm_type type, void *kva);
+struct page *file_backed_unmap(struct page *page);
+struct page *file_backed_clean(struct frame *frame);
 void *do_mmap(void *addr, size_t length, int writable,
 			  struct file *file, off_t offset);
 void do_munmap(void *va);
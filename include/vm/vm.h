@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <hash.h>
 #include "threads/palloc.h"
+#include "threads/synch.h"
 
 enum vm_type
 {
@@ -35,7 +36,6 @@ enum vm_type
 
 struct page_operations;
 struct thread;
-struct list frame_table;
 struct lock frame_lock;
 
 #define VM_TYPE(type) ((type)&7)
@@ -56,6 +56,7 @@ struct page
 	bool writable;
 	bool write_protected;
 	uint64_t *pml4;
+	unsigned long wb_seq; // 이 페이지를 기록 중인 kswapd 배치 번호
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
 	union
@@ -70,13 +71,26 @@ struct page
 };
 
 /* The representation of "frame" */
+/* One per user pool page, in a table indexed by
+ * (kva - user pool base) >> PGBITS. */
 struct frame
 {
 	void *kva;
 	struct page *page;
 	struct list page_list;
-	struct list_elem frame_elem;
+	struct list_elem frame_elem; // cold 프레임의 FIFO (2Q의 A1)
 	int cnt_page;
+	bool in_use; // 페이지를 담고 있는 프레임
+	unsigned pin_cnt; // 0이 아니면 쫓아내지 않는다: 채우는 중이거나 커널이 쓰는 중
+	bool hot;	 // 다시 쓰인 적 있는 프레임: CLOCK-Pro의 hot, 2Q의 Am
+};
+
+/* Page replacement policies, chosen with -vmp on the command line. */
+enum vm_policy
+{
+	VM_POLICY_CLOCK,	/* Clock, preferring clean frames. */
+	VM_POLICY_CLOCKPRO, /* Two-handed clock with hot and cold frames. */
+	VM_POLICY_2Q,		/* FIFO for new frames, clock for reused ones. */
 };
 
 struct load
@@ -111,6 +125,7 @@ struct page_operations
 struct supplemental_page_table
 {
 	struct hash spt_hash;
+	struct rwlock spt_lock; /* Lookups shared, insert/delete exclusive. */
 };
 
 #include "threads/thread.h"
@@ -133,6 +148,22 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage,
 									bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page(struct page *page);
 bool vm_claim_page(void *va);
+struct frame *vm_try_get_frame(void);
+
+/* Free user frames below which the page-out daemon wakes, and up to
+   which it pages out.  Set by -wl and -wh on the command line. */
+extern size_t vm_low_watermark;
+extern size_t vm_high_watermark;
+void vm_wake_kswapd(void);
+void vm_wait_writeback(struct page *page);
+void vm_pin_buffer(void *buffer, size_t size, bool write);
+void vm_unpin_buffer(void *buffer, size_t size);
+bool vm_writeback_pending(const struct page *page);
+
+extern enum vm_policy vm_policy;
+bool vm_set_policy(const char *name);
+void vm_frame_remove(struct frame *frame);
+void vm_print_stats(void);
 enum vm_type page_get_type(struct page *page);
 
 #endif /* VM_VM_H */
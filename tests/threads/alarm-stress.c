@@ -0,0 +1,108 @@
+/* Creates 1000 threads, each of which sleeps once until a
+   different tick spread over several hundred ticks, so the timer
+   interrupt has to manage a large population of sleepers.
+   Verifies that no thread wakes up early and reports the average
+   cost of the timer interrupt handler while they sleep. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEPER_CNT 1000
+#define SLEEP_SPREAD 600
+
+/* Information about the test. */
+struct stress_test
+  {
+    int64_t start;              /* Current time at start of test. */
+    struct semaphore done;      /* Upped once by each sleeper. */
+    struct lock lock;           /* Protects early_cnt. */
+    int early_cnt;              /* # of threads woken too soon. */
+  };
+
+/* Information about an individual thread in the test. */
+struct stress_thread
+  {
+    struct stress_test *test;   /* Info about the test. */
+    int64_t wakeup;             /* Tick to wake up at. */
+  };
+
+static void sleeper (void *);
+
+void
+test_alarm_stress (void) 
+{
+  struct stress_test test;
+  struct stress_thread *threads;
+  int64_t start_ticks, elapsed;
+  uint64_t start_cycles, cycles;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("Creating %d threads to sleep once each.", SLEEPER_CNT);
+  msg ("Wake-up times are spread over %d ticks.", SLEEP_SPREAD);
+
+  threads = malloc (sizeof *threads * SLEEPER_CNT);
+  if (threads == NULL)
+    PANIC ("couldn't allocate memory for test");
+
+  test.start = timer_ticks () + 100;
+  sema_init (&test.done, 0);
+  lock_init (&test.lock);
+  test.early_cnt = 0;
+
+  for (i = 0; i < SLEEPER_CNT; i++)
+    {
+      struct stress_thread *t = threads + i;
+      char name[16];
+
+      t->test = &test;
+      t->wakeup = test.start + (i * 37) % SLEEP_SPREAD;
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper, t) == TID_ERROR)
+        fail ("couldn't create thread %d", i);
+    }
+
+  /* Measure the handler while every thread sleeps. */
+  timer_sleep (test.start - timer_ticks ());
+  start_ticks = timer_ticks ();
+  start_cycles = timer_handler_cycles ();
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&test.done);
+  elapsed = timer_elapsed (start_ticks);
+  cycles = timer_handler_cycles () - start_cycles;
+
+  msg ("All %d threads woke up.", SLEEPER_CNT);
+  if (test.early_cnt != 0)
+    fail ("%d threads woke up early", test.early_cnt);
+  msg ("No thread woke up early.");
+  if (elapsed > 0)
+    msg ("tick handler cost: %"PRIu64" cycles/tick over %"PRId64" ticks",
+         cycles / elapsed, elapsed);
+
+  free (threads);
+}
+
+/* Sleeper thread. */
+static void
+sleeper (void *t_) 
+{
+  struct stress_thread *t = t_;
+  struct stress_test *test = t->test;
+
+  timer_sleep (t->wakeup - timer_ticks ());
+  if (timer_ticks () < t->wakeup)
+    {
+      lock_acquire (&test->lock);
+      test->early_cnt++;
+      lock_release (&test->lock);
+    }
+  sema_up (&test->done);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = grep (!/tick handler cost:/, @output);
+compare_output ("run", \@output, [<<'EOF']);
+(alarm-stress) begin
+(alarm-stress) Creating 1000 threads to sleep once each.
+(alarm-stress) Wake-up times are spread over 600 ticks.
+(alarm-stress) All 1000 threads woke up.
+(alarm-stress) No thread woke up early.
+(alarm-stress) end
+EOF
+pass;
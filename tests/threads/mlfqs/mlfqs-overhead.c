@@ -0,0 +1,89 @@
+/* Measures the cost of the advanced scheduler's bookkeeping in
+   the timer interrupt with 100, 500 and 1000 CPU-bound threads.
+
+   Each round creates the threads, lets them all spin for 2
+   seconds, and reports the average number of TSC cycles spent in
+   the timer interrupt handler per tick over that period.  Nothing
+   about the numbers is checked; the test only verifies that every
+   thread ran to completion. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Information about one measurement round. */
+struct overhead_test
+  {
+    int64_t start;              /* Tick at which threads start spinning. */
+    int64_t stop;               /* Tick at which threads stop spinning. */
+    struct semaphore done;      /* Upped once by each spinner. */
+  };
+
+static void measure (int thread_cnt);
+static void spinner (void *);
+
+void
+test_mlfqs_overhead (void) 
+{
+  ASSERT (thread_mlfqs);
+
+  measure (100);
+  measure (500);
+  measure (1000);
+}
+
+static void
+measure (int thread_cnt) 
+{
+  struct overhead_test test;
+  int64_t start_ticks, elapsed;
+  uint64_t start_cycles, cycles;
+  int i;
+
+  msg ("Starting %d spinning threads for 2 seconds.", thread_cnt);
+
+  test.start = timer_ticks () + TIMER_FREQ;
+  test.stop = test.start + 2 * TIMER_FREQ;
+  sema_init (&test.done, 0);
+
+  for (i = 0; i < thread_cnt; i++)
+    {
+      char name[32];
+      snprintf (name, sizeof name, "spinner %d", i);
+      if (thread_create (name, PRI_DEFAULT, spinner, &test) == TID_ERROR)
+        fail ("couldn't create thread %d", i);
+    }
+
+  timer_sleep (test.start - timer_ticks ());
+  start_ticks = timer_ticks ();
+  start_cycles = timer_handler_cycles ();
+  for (i = 0; i < thread_cnt; i++)
+    sema_down (&test.done);
+  elapsed = timer_elapsed (start_ticks);
+  cycles = timer_handler_cycles () - start_cycles;
+
+  msg ("All %d threads finished.", thread_cnt);
+  if (elapsed > 0)
+    msg ("scheduler overhead with %d threads: %"PRIu64" cycles/tick",
+         thread_cnt, cycles / elapsed);
+
+  /* Let the spinners exit before the next round. */
+  timer_sleep (TIMER_FREQ / 2);
+}
+
+/* Sleeps until the round starts, then burns CPU until it ends. */
+static void
+spinner (void *test_) 
+{
+  struct overhead_test *test = test_;
+
+  timer_sleep (test->start - timer_ticks ());
+  while (timer_ticks () < test->stop)
+    continue;
+  sema_up (&test->done);
+}
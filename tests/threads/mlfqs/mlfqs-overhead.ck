@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = grep (!/scheduler overhead with/, @output);
+compare_output ("run", \@output, [<<'EOF']);
+(mlfqs-overhead) begin
+(mlfqs-overhead) Starting 100 spinning threads for 2 seconds.
+(mlfqs-overhead) All 100 threads finished.
+(mlfqs-overhead) Starting 500 spinning threads for 2 seconds.
+(mlfqs-overhead) All 500 threads finished.
+(mlfqs-overhead) Starting 1000 spinning threads for 2 seconds.
+(mlfqs-overhead) All 1000 threads finished.
+(mlfqs-overhead) end
+EOF
+pass;
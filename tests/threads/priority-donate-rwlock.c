@@ -0,0 +1,84 @@
+/* The main thread and a "reader" thread both hold an rwlock for
+   reading.  A higher-priority "writer" thread then blocks trying
+   to write, which must donate its priority to both readers.  A
+   "late" reader that arrives while the writer waits must queue
+   behind it, since writers are preferred.  As the readers let go,
+   the writer and then the late reader should get the rwlock. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+struct rwlock_test
+  {
+    struct rwlock rwlock;
+    struct semaphore go;
+  };
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+static thread_func late_thread_func;
+
+void
+test_priority_donate_rwlock (void) 
+{
+  struct rwlock_test t;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&t.rwlock);
+  sema_init (&t.go, 0);
+  rwlock_acquire_read (&t.rwlock);
+  thread_create ("reader", PRI_DEFAULT + 1, reader_thread_func, &t);
+  thread_create ("writer", PRI_DEFAULT + 10, writer_thread_func, &t);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 10, thread_get_priority ());
+  thread_create ("late", PRI_DEFAULT + 5, late_thread_func, &t);
+  rwlock_release (&t.rwlock);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+  sema_up (&t.go);
+  msg ("writer, late, reader must already have finished, in that order.");
+}
+
+static void
+reader_thread_func (void *t_) 
+{
+  struct rwlock_test *t = t_;
+
+  rwlock_acquire_read (&t->rwlock);
+  msg ("reader: got shared access");
+  sema_down (&t->go);
+  msg ("reader: should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 10, thread_get_priority ());
+  rwlock_release (&t->rwlock);
+  msg ("reader: done");
+}
+
+static void
+writer_thread_func (void *t_) 
+{
+  struct rwlock_test *t = t_;
+
+  rwlock_acquire_write (&t->rwlock);
+  msg ("writer: got exclusive access");
+  rwlock_release (&t->rwlock);
+  msg ("writer: done");
+}
+
+static void
+late_thread_func (void *t_) 
+{
+  struct rwlock_test *t = t_;
+
+  rwlock_acquire_read (&t->rwlock);
+  msg ("late: got shared access");
+  rwlock_release (&t->rwlock);
+  msg ("late: done");
+}
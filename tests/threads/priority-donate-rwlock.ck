@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-rwlock) begin
+(priority-donate-rwlock) reader: got shared access
+(priority-donate-rwlock) This thread should have priority 41.  Actual priority: 41.
+(priority-donate-rwlock) This thread should have priority 31.  Actual priority: 31.
+(priority-donate-rwlock) reader: should have priority 41.  Actual priority: 41.
+(priority-donate-rwlock) writer: got exclusive access
+(priority-donate-rwlock) writer: done
+(priority-donate-rwlock) late: got shared access
+(priority-donate-rwlock) late: done
+(priority-donate-rwlock) reader: done
+(priority-donate-rwlock) writer, late, reader must already have finished, in that order.
+(priority-donate-rwlock) end
+EOF
+pass;
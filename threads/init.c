@@ -216,6 +216,8 @@ parse_options (char **argv) {
 #ifdef FILESYS
 		else if (!strcmp (name, "-f"))
 			format_filesys = true;
+		else if (!strcmp (name, "-extents"))
+			filesys_format_extents = true;
 #endif
 		else if (!strcmp (name, "-rs"))
 			random_init (atoi (value));
@@ -226,6 +228,16 @@ parse_options (char **argv) {
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-wl"))
+			vm_low_watermark = atoi (value);
+		else if (!strcmp (name, "-wh"))
+			vm_high_watermark = atoi (value);
+		else if (!strcmp (name, "-vmp")) {
+			if (!vm_set_policy (value))
+				PANIC ("unknown replacement policy `%s'", value);
+		}
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -324,10 +336,18 @@ usage (void) {
 			"  -h                 Print this help message and power off.\n"
 			"  -q                 Power off VM after actions or on panic.\n"
 			"  -f                 Format file system disk during startup.\n"
+#ifdef FILESYS
+			"  -extents           With -f, index new files by extents.\n"
+#endif
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -wl=COUNT          Page out in the background below COUNT free user pages.\n"
+			"  -wh=COUNT          Page out in the background up to COUNT free user pages.\n"
+			"  -vmp=POLICY        Replace pages by POLICY: clock, clockpro or 2q.\n"
 #endif
 			);
 	power_off ();
@@ -354,6 +374,7 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	lock_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
@@ -362,4 +383,7 @@ print_stats (void) {
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	vm_print_stats ();
+#endif
 }
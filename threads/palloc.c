@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -32,6 +33,9 @@ struct pool
 	struct lock lock;		 /* Mutual exclusion. */
 	struct bitmap *used_map; /* Bitmap of free pages. */
 	uint8_t *base;			 /* Base of pool. */
+	size_t free_cnt;		 /* Free pages, guarded by disabling
+								interrupts since pages are freed
+								without the lock. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -252,6 +256,7 @@ populate_pools(struct area *base_mem, struct area *ext_mem)
 			{
 				page_cnt = ((uint64_t)pool_end - start) / PGSIZE;
 				bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+				pool->free_cnt += page_cnt;
 				start = (uint64_t)pool_end;
 				goto split;
 			}
@@ -259,6 +264,7 @@ populate_pools(struct area *base_mem, struct area *ext_mem)
 			{
 				page_cnt = ((uint64_t)end - start) / PGSIZE;
 				bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+				pool->free_cnt += page_cnt;
 			}
 		}
 	}
@@ -297,6 +303,12 @@ palloc_get_multiple(enum palloc_flags flags, size_t page_cnt)
 
 	lock_acquire(&pool->lock);
 	size_t page_idx = bitmap_scan_and_flip(pool->used_map, 0, page_cnt, false);
+	if (page_idx != BITMAP_ERROR)
+	{
+		enum intr_level old_level = intr_disable();
+		pool->free_cnt -= page_cnt;
+		intr_set_level(old_level);
+	}
 	lock_release(&pool->lock);
 	void *pages;
 
@@ -356,6 +368,29 @@ void palloc_free_multiple(void *pages, size_t page_cnt)
 #endif
 	ASSERT(bitmap_all(pool->used_map, page_idx, page_cnt));
 	bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+	enum intr_level old_level = intr_disable();
+	pool->free_cnt += page_cnt;
+	intr_set_level(old_level);
+}
+
+/* Returns the first page of the user pool if PAL_USER is set in
+   FLAGS, of the kernel pool otherwise, and stores the number of
+   pages the pool spans, usable or not, in *PAGE_CNT. */
+void *
+palloc_pool_range(enum palloc_flags flags, size_t *page_cnt)
+{
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	*page_cnt = bitmap_size(pool->used_map);
+	return pool->base;
+}
+
+/* Returns the number of free pages in the user pool if PAL_USER is
+   set in FLAGS, in the kernel pool otherwise. */
+size_t
+palloc_free_cnt(enum palloc_flags flags)
+{
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	return pool->free_cnt;
 }
 
 /* Frees the page at PAGE. */
@@ -377,6 +412,7 @@ init_pool(struct pool *p, void **bm_base, uint64_t start, uint64_t end)
 	lock_init(&p->lock);
 	p->used_map = bitmap_create_in_buf(pgcnt, *bm_base, bm_pages);
 	p->base = (void *)start;
+	p->free_cnt = 0;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
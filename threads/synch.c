@@ -182,6 +182,74 @@ void lock_init(struct lock *lock)
 
 	lock->holder = NULL;
 	sema_init(&lock->semaphore, 1);
+	lock->stats = NULL;
+}
+
+/* Number of times an adaptive lock yields and retries before it
+   falls back to blocking with priority donation. */
+#define LOCK_RETRY_TRIES 4
+
+/* Statistics of all adaptive locks, for lock_print_stats(). */
+static struct lock_stats *adaptive_locks;
+
+/* Initializes LOCK as an adaptive lock named NAME.  Adaptive locks
+   are meant for short critical sections in hot subsystems.  When
+   one is found held, the acquirer yields and retries a few times,
+   so that a holder that is only preempted can finish its short
+   critical section, and only then falls back to the donation path
+   and blocks.  With a single CPU the holder is never running while
+   somebody else tries the lock, so spinning would only burn the
+   holder's time.  A holder of lower priority than the acquirer
+   would not run on a yield, so that case goes to the donation path
+   at once.  Acquisition and contention counts are kept in STATS,
+   which the caller provides and which must outlive LOCK, for
+   lock_print_stats(). */
+void lock_init_adaptive(struct lock *lock, struct lock_stats *stats, const char *name)
+{
+	enum intr_level old_level;
+
+	ASSERT(stats != NULL);
+	ASSERT(name != NULL);
+
+	lock_init(lock);
+	stats->name = name;
+	stats->acquire_cnt = stats->contend_cnt = stats->retry_cnt = 0;
+	lock->stats = stats;
+
+	old_level = intr_disable();
+	stats->next = adaptive_locks;
+	adaptive_locks = stats;
+	intr_set_level(old_level);
+}
+
+/* Tries to get a contended adaptive LOCK by yielding to its holder
+   and retrying, without blocking.  Returns true if it was
+   acquired. */
+static bool
+lock_try_adaptive(struct lock *lock)
+{
+	if (intr_get_level() == INTR_OFF) // 양보할 수 없으니 holder가 풀어 줄 일도 없다
+		return false;
+	for (int i = 0; i < LOCK_RETRY_TRIES; i++)
+	{
+		struct thread *holder = lock->holder;
+
+		if (!thread_mlfqs && holder != NULL && thread_get_priority() > holder->priority)
+			return false; // 양보해도 holder가 돌지 못하므로 바로 donation
+		thread_yield();
+		if (lock_try_acquire(lock))
+			return true;
+	}
+	return false;
+}
+
+/* Prints acquisition statistics for every adaptive lock. */
+void lock_print_stats(void)
+{
+	for (struct lock_stats *s = adaptive_locks; s != NULL; s = s->next)
+		if (s->acquire_cnt > 0)
+			printf("Lock %s: %u acquires, %u contended, %u without blocking\n",
+				   s->name, s->acquire_cnt, s->contend_cnt, s->retry_cnt);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -199,7 +267,23 @@ void lock_acquire(struct lock *lock)
 	ASSERT(!lock_held_by_current_thread(lock));
 
 	struct thread *curr = thread_current();
-	if (lock->holder != NULL) // 이미 점유중인 락이라면
+	if (lock->stats != NULL) // adaptive lock: donation 없이 먼저 시도
+	{
+		if (lock_try_acquire(lock))
+		{
+			lock->stats->acquire_cnt++;
+			return;
+		}
+		if (lock_try_adaptive(lock))
+		{
+			lock->stats->acquire_cnt++;
+			lock->stats->contend_cnt++;
+			lock->stats->retry_cnt++;
+			return;
+		}
+	}
+
+	if (!thread_mlfqs && lock->holder != NULL) // 이미 점유중인 락이라면 (mlfqs는 donation 없음)
 	{
 		curr->wait_on_lock = lock; // 현재 스레드의 wait_on_lock으로 지정
 		// lock holder의 donors list에 현재 스레드 추가
@@ -212,6 +296,11 @@ void lock_acquire(struct lock *lock)
 	curr->wait_on_lock = NULL; // lock을 점유했으니 wait_on_lock에서 제거
 
 	lock->holder = thread_current();
+	if (lock->stats != NULL) // 여기까지 왔다면 adaptive lock은 경합이 있었던 것
+	{
+		lock->stats->acquire_cnt++;
+		lock->stats->contend_cnt++;
+	}
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -244,8 +333,11 @@ void lock_release(struct lock *lock)
 	ASSERT(lock != NULL);
 	ASSERT(lock_held_by_current_thread(lock));
 
-	remove_donor(lock);
-	update_priority_for_donations();
+	if (!thread_mlfqs)
+	{
+		remove_donor(lock);
+		update_priority_for_donations();
+	}
 
 	lock->holder = NULL;
 	sema_up(&lock->semaphore);
@@ -261,6 +353,218 @@ bool lock_held_by_current_thread(const struct lock *lock)
 	return lock->holder == thread_current();
 }
 
+/* Initializes RW as an rwlock with no holders. */
+void rwlock_init(struct rwlock *rw)
+{
+	ASSERT(rw != NULL);
+
+	rw->readers = 0;
+	rw->writer = NULL;
+	list_init(&rw->read_waiters);
+	list_init(&rw->write_waiters);
+	list_init(&rw->holders);
+}
+
+/* Records that T holds RW.  Interrupts must be off. */
+static void
+rw_hold_add(struct rwlock *rw, struct thread *t)
+{
+	for (int i = 0; i < RW_HOLD_MAX; i++)
+		if (t->rw_holds[i].rwlock == NULL)
+		{
+			t->rw_holds[i].rwlock = rw;
+			t->rw_holds[i].thread = t;
+			list_push_back(&rw->holders, &t->rw_holds[i].elem);
+			return;
+		}
+	PANIC("thread %s holds too many rwlocks", t->name);
+}
+
+/* Returns T's hold on RW, or NULL if T does not hold it.  With
+   RW null, returns one of T's unused holds, or NULL if all are in
+   use. */
+static struct rw_hold *
+rw_hold_find(const struct thread *t, const struct rwlock *rw)
+{
+	for (int i = 0; i < RW_HOLD_MAX; i++)
+		if (t->rw_holds[i].rwlock == rw)
+			return (struct rw_hold *)&t->rw_holds[i];
+	return NULL;
+}
+
+/* Deepest chain of nested donation followed. */
+#define DONATE_DEPTH 8
+
+// holder와, holder가 기다리는 lock 또는 rwlock의 holder들에게 priority 상속
+// DEPTH는 지금까지 따라온 단계 수. 인터럽트가 꺼져 있어야 한다
+static void
+donate_priority_to(struct thread *holder, int priority, int depth)
+{
+	struct list_elem *e;
+
+	if (holder == NULL || depth >= DONATE_DEPTH)
+		return;
+	if (holder->priority < priority)
+		thread_change_priority(holder, priority);
+	if (holder->wait_on_lock != NULL)
+		donate_priority_to(holder->wait_on_lock->holder, priority, depth + 1);
+	else if (holder->wait_on_rwlock != NULL) // rwlock은 holder가 여럿일 수 있다
+	{
+		struct rwlock *rw = holder->wait_on_rwlock;
+		for (e = list_begin(&rw->holders); e != list_end(&rw->holders); e = list_next(e))
+			donate_priority_to(list_entry(e, struct rw_hold, elem)->thread, priority, depth + 1);
+	}
+}
+
+/* Blocks the current thread on WAITERS of RW, donating its
+   priority to every holder of RW.  When the thread wakes up, the
+   releasing thread has already made it a holder.  Interrupts must
+   be off. */
+static void
+rwlock_wait(struct rwlock *rw, struct list *waiters)
+{
+	struct thread *curr = thread_current();
+	struct list_elem *e;
+
+	curr->wait_on_rwlock = rw;
+	list_push_back(waiters, &curr->elem);
+	if (!thread_mlfqs)
+		for (e = list_begin(&rw->holders); e != list_end(&rw->holders); e = list_next(e))
+			donate_priority_to(list_entry(e, struct rw_hold, elem)->thread, curr->priority, 0);
+	thread_block();
+	curr->wait_on_rwlock = NULL;
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or is
+   waiting for it.  The current thread must not already hold RW. */
+void rwlock_acquire_read(struct rwlock *rw)
+{
+	enum intr_level old_level;
+
+	ASSERT(rw != NULL);
+	ASSERT(!intr_context());
+	ASSERT(!rwlock_held_by_current_thread(rw));
+	ASSERT(rw_hold_find(thread_current(), NULL) != NULL); // 빈 hold가 남아 있어야 한다
+
+	old_level = intr_disable();
+	if (rw->writer != NULL || !list_empty(&rw->write_waiters))
+		rwlock_wait(rw, &rw->read_waiters);
+	else
+	{
+		rw->readers++;
+		rw_hold_add(rw, thread_current());
+	}
+	intr_set_level(old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  The current thread must not already hold RW. */
+void rwlock_acquire_write(struct rwlock *rw)
+{
+	enum intr_level old_level;
+
+	ASSERT(rw != NULL);
+	ASSERT(!intr_context());
+	ASSERT(!rwlock_held_by_current_thread(rw));
+	ASSERT(rw_hold_find(thread_current(), NULL) != NULL); // 빈 hold가 남아 있어야 한다
+
+	old_level = intr_disable();
+	if (rw->writer != NULL || rw->readers > 0)
+		rwlock_wait(rw, &rw->write_waiters);
+	else
+	{
+		rw->writer = thread_current();
+		rw_hold_add(rw, thread_current());
+	}
+	intr_set_level(old_level);
+}
+
+/* Releases RW, which the current thread must hold in either mode.
+   When the last holder leaves, RW is handed to the highest-priority
+   waiting writer or, if there is none, to all waiting readers. */
+void rwlock_release(struct rwlock *rw)
+{
+	struct thread *curr = thread_current();
+	struct rw_hold *hold;
+	enum intr_level old_level;
+
+	ASSERT(rw != NULL);
+
+	old_level = intr_disable();
+	hold = rw_hold_find(curr, rw);
+	ASSERT(hold != NULL);
+	list_remove(&hold->elem);
+	hold->rwlock = NULL;
+
+	if (rw->writer == curr)
+		rw->writer = NULL;
+	else
+		rw->readers--;
+
+	if (rw->writer == NULL && rw->readers == 0)
+	{
+		if (!list_empty(&rw->write_waiters))
+		{
+			struct list_elem *e = list_min(&rw->write_waiters, cmp_thread_priority, NULL); // priority가 가장 높은 writer
+			struct thread *t = list_entry(e, struct thread, elem);
+
+			list_remove(e);
+			rw->writer = t;
+			rw_hold_add(rw, t);
+			thread_unblock(t);
+		}
+		else
+			while (!list_empty(&rw->read_waiters))
+			{
+				struct thread *t = list_entry(list_pop_front(&rw->read_waiters), struct thread, elem);
+
+				rw->readers++;
+				rw_hold_add(rw, t);
+				thread_unblock(t);
+			}
+	}
+
+	if (!thread_mlfqs)
+		update_priority_for_donations();
+	intr_set_level(old_level);
+	preempt_priority();
+}
+
+/* Returns true if the current thread holds RW in either mode. */
+bool rwlock_held_by_current_thread(const struct rwlock *rw)
+{
+	ASSERT(rw != NULL);
+
+	return rw_hold_find(thread_current(), rw) != NULL;
+}
+
+/* Returns the highest priority among threads waiting on rwlocks
+   that T holds, or PRI_MIN if there are none.  Interrupts must be
+   off. */
+int rwlock_waiter_priority(const struct thread *t)
+{
+	int priority = PRI_MIN;
+
+	for (int i = 0; i < RW_HOLD_MAX; i++)
+	{
+		struct rwlock *rw = t->rw_holds[i].rwlock;
+		struct list *lists[2];
+
+		if (rw == NULL)
+			continue;
+		lists[0] = &rw->read_waiters;
+		lists[1] = &rw->write_waiters;
+		for (int j = 0; j < 2; j++)
+			for (struct list_elem *e = list_begin(lists[j]); e != list_end(lists[j]); e = list_next(e))
+			{
+				struct thread *w = list_entry(e, struct thread, elem);
+				if (w->priority > priority)
+					priority = w->priority;
+			}
+	}
+	return priority;
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem
 {
@@ -380,24 +684,16 @@ bool cmp_donation_priority(const struct list_elem *a,
 }
 
 // 현재 스레드가 원하는 락을 가진 holder에게 현재 스레드의 priority 상속
+// holder가 다른 lock이나 rwlock을 기다리고 있으면 그 holder들에게도 따라간다
 void donate_priority(void)
 {
 	struct thread *curr = thread_current(); // 검사중인 스레드
-	struct thread *holder;					// curr이 원하는 락을 가진드스레드
-
-	int priority = curr->priority;
+	enum intr_level old_level;
 
-	for (int i = 0; i < 8; i++)
-	{
-		if (curr->wait_on_lock == NULL) // 더이상 중첩되지 않았으면 종료
-			return;
-		holder = curr->wait_on_lock->holder;
-		if (holder == NULL)
-			return;
-		if (holder->priority < priority)
-			holder->priority = priority;
-		curr = holder;
-	}
+	old_level = intr_disable(); // rwlock의 holders 목록은 인터럽트를 꺼서 보호된다
+	if (curr->wait_on_lock != NULL)
+		donate_priority_to(curr->wait_on_lock->holder, curr->priority, 0);
+	intr_set_level(old_level);
 }
 
 // donors list를 돌면서 현재 release될 락을 기다리고 있던 donors를 삭제
@@ -429,13 +725,20 @@ void update_priority_for_donations(void)
 	struct thread *curr = thread_current();
 	struct list *donations = &(thread_current()->donations);
 	struct thread *donations_root;
+	int priority = curr->init_priority; // donors가 없으면 최초의 priority로 변경
+	int rw_priority;
+	enum intr_level old_level;
 
-	if (list_empty(donations)) // donors가 없으면 (donor가 하나였던 경우)
+	old_level = intr_disable(); // rwlock의 waiters 목록은 인터럽트를 꺼서 보호된다
+	if (!list_empty(donations))
 	{
-		curr->priority = curr->init_priority; // 최초의 priority로 변경
-		return;
+		donations_root = list_entry(list_front(donations), struct thread, donation_elem);
+		priority = donations_root->priority;
 	}
 
-	donations_root = list_entry(list_front(donations), struct thread, donation_elem);
-	curr->priority = donations_root->priority;
+	rw_priority = rwlock_waiter_priority(curr); // 점유 중인 rwlock을 기다리는 스레드의 priority
+	if (rw_priority > priority)
+		priority = rw_priority;
+	thread_change_priority(curr, priority);
+	intr_set_level(old_level);
 }
\ No newline at end of file
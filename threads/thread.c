@@ -11,6 +11,7 @@
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "intrinsic.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "filesys/directory.h"
@@ -25,10 +26,45 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-static struct list sleep_list;
+/* Run queue of processes in THREAD_READY state, that is, processes
+   that are ready to run but not actually running.  There is one
+   FIFO list per priority level, and bit N of ready_bitmap is set
+   while ready_queues[N] is non-empty, so the highest ready
+   priority is found with a single find-last-set. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_bitmap;
+
+/* Sleeping threads live in a hierarchical timing wheel keyed on
+   wakeup_ticks.  Level 0 has one slot per tick for the next
+   WHEEL_L0_SIZE ticks; each higher level has WHEEL_LN_SIZE slots,
+   each spanning one full turn of the level below.  A slot is
+   cascaded into the lower levels when the hand reaches it, so
+   insertion is O(1) and expiry is amortized O(1) per tick. */
+#define WHEEL_LEVELS 4
+#define WHEEL_L0_BITS 8
+#define WHEEL_LN_BITS 6
+#define WHEEL_L0_SIZE (1 << WHEEL_L0_BITS)
+#define WHEEL_LN_SIZE (1 << WHEEL_LN_BITS)
+#define WHEEL_SHIFT(LEVEL) (WHEEL_L0_BITS + ((LEVEL)-1) * WHEEL_LN_BITS)
+#define WHEEL_INDEX(TICKS, LEVEL) (((TICKS) >> WHEEL_SHIFT(LEVEL)) & (WHEEL_LN_SIZE - 1))
+
+static struct list wheel_l0[WHEEL_L0_SIZE];
+static struct list wheel_ln[WHEEL_LEVELS - 1][WHEEL_LN_SIZE];
+static int64_t wheel_base;		  /* Next tick the wheel will process. */
+static int64_t next_wakeup_ticks; /* No sleeper is due before this tick. */
+static size_t sleeper_cnt;		  /* # of threads in the wheel. */
+
+/* List of all processes.  Processes are added to this list
+   when they are created and removed when they exit. */
+static struct list all_list;
+
+/* Advanced scheduler state.  Between the once-a-second updates
+   only the running thread's recent_cpu changes, so threads that
+   were charged CPU time since the last priority recalculation are
+   kept on dirty_list and only they are revisited every 4 ticks. */
+static fixed_t load_avg;	   /* System load average. */
+static size_t ready_cnt;	   /* # of threads in the run queue. */
+static struct list dirty_list; /* Threads whose recent_cpu changed. */
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -64,6 +100,17 @@ static void init_thread(struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule(void);
 static tid_t allocate_tid(void);
+static void ready_queue_push(struct thread *);
+static void ready_queue_remove(struct thread *);
+static int ready_queue_max_priority(void);
+static void wheel_insert(struct thread *);
+static void wheel_cascade(int level, int idx);
+static void wheel_advance(void);
+static int64_t wheel_boundary(void);
+static int64_t wheel_next_deadline(void);
+static void mlfqs_tick(int64_t ticks);
+static void mlfqs_update_priority(struct thread *);
+static int mlfqs_priority(const struct thread *);
 
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
@@ -108,8 +155,19 @@ void thread_init(void)
 
 	/* Init the globla thread context */
 	lock_init(&tid_lock);
-	list_init(&ready_list);
-	list_init(&sleep_list); // sleep_list 초기화
+	for (int i = PRI_MIN; i <= PRI_MAX; i++)
+		list_init(&ready_queues[i]);
+	ready_bitmap = 0;
+	for (int i = 0; i < WHEEL_L0_SIZE; i++) // timing wheel 초기화
+		list_init(&wheel_l0[i]);
+	for (int level = 1; level < WHEEL_LEVELS; level++)
+		for (int i = 0; i < WHEEL_LN_SIZE; i++)
+			list_init(&wheel_ln[level - 1][i]);
+	wheel_base = 1;
+	next_wakeup_ticks = INT64_MAX;
+	list_init(&all_list);
+	list_init(&dirty_list);
+	load_avg = fp_from_int(0);
 	list_init(&destruction_req);
 
 	/* Set up a thread structure for the running thread. */
@@ -151,6 +209,9 @@ void thread_tick(void)
 	else
 		kernel_ticks++;
 
+	if (thread_mlfqs)
+		mlfqs_tick(timer_ticks());
+
 	/* Enforce preemption. */
 	if (++thread_ticks >= TIME_SLICE)
 		intr_yield_on_return();
@@ -188,18 +249,14 @@ bool cmp_thread_priority(const struct list_elem *a, const struct list_elem *b, v
 
 void preempt_priority(void)
 {
-	// ASSERT(thread_current() != idle_thread);
-	// ASSERT(!list_empty(&ready_list))
 	if (thread_current() == idle_thread)
 		return;
-	if (list_empty(&ready_list))
-		return;
-	struct thread *cur = thread_current();
-	struct thread *first_ready = list_entry(list_front(&ready_list), struct thread, elem);
-
-	if (first_ready->priority > cur->priority)
-	{ // ready_list 첫번째 스레드가 현재 실행 스레드보다 우선순위가 높으면, 양보
-		thread_yield();
+	if (ready_queue_max_priority() > thread_current()->priority)
+	{ // run queue의 최고 우선순위가 현재 실행 스레드보다 높으면, 양보
+		if (intr_context())
+			intr_yield_on_return();
+		else
+			thread_yield();
 	}
 }
 
@@ -219,6 +276,12 @@ tid_t thread_create(const char *name, int priority,
 	/* Initialize thread. */
 	init_thread(t, name, priority);
 	tid = t->tid = allocate_tid();
+	if (thread_mlfqs)
+	{ // 부모의 nice, recent_cpu를 상속하고 priority는 직접 계산
+		t->nice = thread_current()->nice;
+		t->recent_cpu = thread_current()->recent_cpu;
+		t->priority = t->init_priority = mlfqs_priority(t);
+	}
 
 	/* Call the kernel_thread if it scheduled. 커널 스레드 레지스터 초기화
 	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
@@ -278,7 +341,7 @@ void thread_unblock(struct thread *t)
 
 	old_level = intr_disable();
 	ASSERT(t->status == THREAD_BLOCKED);
-	list_insert_ordered(&ready_list, &t->elem, cmp_thread_priority, NULL);
+	ready_queue_push(t);
 	t->status = THREAD_READY;
 	intr_set_level(old_level);
 	// preempt_priority();
@@ -333,6 +396,9 @@ void thread_exit(void)
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable();
+	list_remove(&thread_current()->all_elem);
+	if (thread_current()->cpu_dirty)
+		list_remove(&thread_current()->dirty_elem);
 	do_schedule(THREAD_DYING);
 	NOT_REACHED();
 }
@@ -348,7 +414,7 @@ void thread_yield(void)
 
 	old_level = intr_disable(); // 인터럽트 비활성
 	if (curr != idle_thread)
-		list_insert_ordered(&ready_list, &curr->elem, cmp_thread_priority, NULL);
+		ready_queue_push(curr);
 	do_schedule(THREAD_READY); // 현재 실행 중인 스레드의 상태를 준비 상태로 변경, 컨텍스트 전환
 	intr_set_level(old_level); // 인터럽트 상태를 원래 상태로 변경
 }
@@ -357,6 +423,7 @@ void thread_sleep(int64_t ticks)
 {
 	struct thread *curr;
 	enum intr_level old_level;
+	int64_t due;
 
 	old_level = intr_disable(); // 인터럽트 비활성
 
@@ -364,46 +431,186 @@ void thread_sleep(int64_t ticks)
 	ASSERT(curr != idle_thread); // 현재 스레드가 idle이 아닐 때만
 	curr->wakeup_ticks = ticks;	 // 일어날 시각 저장
 
-	list_insert_ordered(&sleep_list, &curr->elem, cmp_thread_ticks, NULL); // sleep_list에 추가
+	/* With no sleepers every slot is empty, so the wheel can jump
+	   straight to the present instead of replaying idle ticks. */
+	if (sleeper_cnt == 0)
+		wheel_base = timer_ticks() + 1;
+	wheel_insert(curr); // timing wheel에 추가
+	sleeper_cnt++;
+
+	/* Stop at the next level-1 cascade at the latest, so a far-off
+	   sleeper never makes the tick handler replay a long run of
+	   ticks in one go. */
+	due = curr->wakeup_ticks < wheel_base ? wheel_base : curr->wakeup_ticks;
+	if (due > wheel_boundary())
+		due = wheel_boundary();
+	if (next_wakeup_ticks > due)
+		next_wakeup_ticks = due;
 
-	thread_block(); // 현재 스레드 재우고 ready_list의 스레드 실행
+	thread_block(); // 현재 스레드 재우고 run queue의 스레드 실행
 
 	intr_set_level(old_level); // 인터럽트 상태를 원래 상태로 변경
 }
 
+/* Wakes every sleeper whose wakeup_ticks has been reached.
+   Called from the timer interrupt on every tick, so the common
+   case of nothing being due is a single comparison. */
 void thread_wakeup(int64_t current_ticks)
 {
 	enum intr_level old_level;
+
+	if (current_ticks < next_wakeup_ticks)
+		return;
+
 	old_level = intr_disable(); // 인터럽트 비활성
+	while (wheel_base <= current_ticks)
+	{
+		wheel_advance();
+
+		/* Every level-0 slot before the next deadline is empty, so
+		   the hand can skip over them. */
+		next_wakeup_ticks = wheel_next_deadline();
+		if (next_wakeup_ticks > current_ticks)
+			wheel_base = current_ticks + 1;
+		else
+			wheel_base = next_wakeup_ticks;
+	}
+	preempt_priority();
+	intr_set_level(old_level); // 인터럽트 상태를 원래 상태로 변경
+}
 
-	struct list_elem *curr_elem = list_begin(&sleep_list); // sleep_list의 첫번째 요소(빈 경우 NULL)
-	while (curr_elem != list_end(&sleep_list))
+/* Files T into the wheel according to T->wakeup_ticks. */
+static void
+wheel_insert(struct thread *t)
+{
+	int64_t expires = t->wakeup_ticks;
+	int64_t delta;
+	int level;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	if (expires < wheel_base)
+		expires = wheel_base; // 이미 지난 시각이면 다음 tick에 깨움
+	delta = expires - wheel_base;
+	if (delta < WHEEL_L0_SIZE)
 	{
-		struct thread *curr_thread = list_entry(curr_elem, struct thread, elem); // 현재 검사중인 elem의 스레드
+		list_push_back(&wheel_l0[expires & (WHEEL_L0_SIZE - 1)], &t->elem);
+		return;
+	}
 
-		if (current_ticks >= curr_thread->wakeup_ticks) // 깰 시간이 됐으면
+	for (level = 1; level < WHEEL_LEVELS; level++)
+	{
+		int64_t span = 1LL << (WHEEL_L0_BITS + level * WHEEL_LN_BITS);
+		if (delta < span || level == WHEEL_LEVELS - 1)
 		{
-			curr_elem = list_remove(curr_elem); // sleep_list에서 제거 & curr_elem에는 다음 elem이 담김
-			thread_unblock(curr_thread);		// ready_list로 이동
-			preempt_priority();
+			/* Beyond the top level's range, park the thread in the
+			   farthest slot; it is refiled when that slot cascades. */
+			if (delta >= span)
+				expires = wheel_base + span - 1;
+			list_push_back(&wheel_ln[level - 1][WHEEL_INDEX(expires, level)], &t->elem);
+			return;
 		}
-		else
-			break;
 	}
-	intr_set_level(old_level); // 인터럽트 상태를 원래 상태로 변경
+	NOT_REACHED();
 }
 
-// 두 스레드의 wakeup_ticks를 비교해서 작으면 true를 반환하는 함수
-bool cmp_thread_ticks(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+/* Refiles every thread in slot IDX of wheel level LEVEL
+   (1-based) relative to the current wheel_base. */
+static void
+wheel_cascade(int level, int idx)
 {
-	struct thread *st_a = list_entry(a, struct thread, elem);
-	struct thread *st_b = list_entry(b, struct thread, elem);
-	return st_a->wakeup_ticks < st_b->wakeup_ticks;
+	struct list *slot = &wheel_ln[level - 1][idx];
+	struct list pending;
+
+	if (list_empty(slot))
+		return;
+	list_init(&pending);
+	list_splice(list_end(&pending), list_begin(slot), list_end(slot));
+	while (!list_empty(&pending))
+		wheel_insert(list_entry(list_pop_front(&pending), struct thread, elem));
+}
+
+/* Processes tick wheel_base: cascades the higher levels whose
+   hand has wrapped, then wakes every thread in the level-0 slot. */
+static void
+wheel_advance(void)
+{
+	int64_t now = wheel_base;
+	struct list *slot;
+	int level;
+
+	for (level = WHEEL_LEVELS - 1; level >= 1; level--)
+		if ((now & ((1LL << WHEEL_SHIFT(level)) - 1)) == 0)
+			wheel_cascade(level, WHEEL_INDEX(now, level));
+
+	slot = &wheel_l0[now & (WHEEL_L0_SIZE - 1)];
+	while (!list_empty(slot))
+	{
+		struct thread *t = list_entry(list_pop_front(slot), struct thread, elem);
+		ASSERT(t->wakeup_ticks <= now);
+		sleeper_cnt--;
+		thread_unblock(t); // run queue로 이동
+	}
+	wheel_base++;
+}
+
+/* Returns the first tick at or after wheel_base on which the
+   level-1 hand moves. */
+static int64_t
+wheel_boundary(void)
+{
+	return (wheel_base + WHEEL_L0_SIZE - 1) & ~(int64_t)(WHEEL_L0_SIZE - 1);
+}
+
+/* Returns a tick before which no sleeper can be due: the first
+   occupied level-0 slot ahead of the hand, or the next level-1
+   cascade if level 0 is empty until then. */
+static int64_t
+wheel_next_deadline(void)
+{
+	int64_t boundary, t;
+
+	if (sleeper_cnt == 0)
+		return INT64_MAX;
+
+	boundary = wheel_boundary();
+	for (t = wheel_base; t < boundary; t++)
+		if (!list_empty(&wheel_l0[t & (WHEEL_L0_SIZE - 1)]))
+			return t;
+	return boundary;
+}
+
+/* Changes T's effective priority to PRIORITY.  If T is sitting
+   in the run queue it is moved to the tail of its new level, so
+   a donation costs O(1) regardless of how many threads are
+   ready. */
+void thread_change_priority(struct thread *t, int priority)
+{
+	enum intr_level old_level;
+
+	ASSERT(is_thread(t));
+	ASSERT(PRI_MIN <= priority && priority <= PRI_MAX);
+
+	old_level = intr_disable();
+	if (t->priority != priority)
+	{
+		if (t->status == THREAD_READY && t != idle_thread)
+		{
+			ready_queue_remove(t);
+			t->priority = priority;
+			ready_queue_push(t);
+		}
+		else
+			t->priority = priority;
+	}
+	intr_set_level(old_level);
 }
 
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void thread_set_priority(int new_priority)
 {
+	if (thread_mlfqs) // advanced scheduler가 priority를 직접 관리
+		return;
 	thread_current()->init_priority = new_priority;
 	update_priority_for_donations();
 	preempt_priority();
@@ -436,31 +643,129 @@ int thread_get_priority(void)
 // 		thread_yield();
 // }
 
-/* Sets the current thread's nice value to NICE. */
-void thread_set_nice(int nice UNUSED)
+/* Sets the current thread's nice value to NICE and recomputes
+   its priority, yielding if it no longer has the highest. */
+void thread_set_nice(int nice)
 {
-	/* TODO: Your implementation goes here */
+	enum intr_level old_level;
+
+	ASSERT(NICE_MIN <= nice && nice <= NICE_MAX);
+
+	old_level = intr_disable();
+	thread_current()->nice = nice;
+	mlfqs_update_priority(thread_current());
+	intr_set_level(old_level);
+	preempt_priority();
 }
 
 /* Returns the current thread's nice value. */
 int thread_get_nice(void)
 {
-	/* TODO: Your implementation goes here */
-	return 0;
+	return thread_current()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int thread_get_load_avg(void)
 {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable();
+	int value = fp_round(load_avg * 100);
+	intr_set_level(old_level);
+	return value;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int thread_get_recent_cpu(void)
 {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable();
+	int value = fp_round(thread_current()->recent_cpu * 100);
+	intr_set_level(old_level);
+	return value;
+}
+
+/* Advanced scheduler bookkeeping for timer tick TICKS.  Runs in
+   the timer interrupt. */
+static void
+mlfqs_tick(int64_t ticks)
+{
+	struct thread *curr = thread_current();
+	struct list_elem *e;
+
+	/* Charge the running thread for this tick. */
+	if (curr != idle_thread)
+	{
+		curr->recent_cpu = fp_add_int(curr->recent_cpu, 1);
+		if (!curr->cpu_dirty)
+		{
+			curr->cpu_dirty = true;
+			list_push_back(&dirty_list, &curr->dirty_elem);
+		}
+	}
+
+	/* Once per second, decay load_avg and every recent_cpu. */
+	if (ticks % TIMER_FREQ == 0)
+	{
+		size_t ready_threads = ready_cnt + (curr != idle_thread);
+		fixed_t coef;
+
+		load_avg = fp_mul(fp_div(fp_from_int(59), fp_from_int(60)), load_avg) + fp_from_int(ready_threads) / 60;
+		coef = fp_div(2 * load_avg, fp_add_int(2 * load_avg, 1));
+
+		for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e))
+		{
+			struct thread *t = list_entry(e, struct thread, all_elem);
+			fixed_t recent_cpu;
+
+			if (t == idle_thread)
+				continue;
+			recent_cpu = fp_add_int(fp_mul(coef, t->recent_cpu), t->nice);
+			if (recent_cpu != t->recent_cpu && !t->cpu_dirty)
+			{
+				t->cpu_dirty = true;
+				list_push_back(&dirty_list, &t->dirty_elem);
+			}
+			t->recent_cpu = recent_cpu;
+		}
+	}
+
+	/* Every fourth tick, recompute the priority of exactly those
+	   threads whose recent_cpu moved. */
+	if (ticks % TIME_SLICE == 0)
+	{
+		while (!list_empty(&dirty_list))
+		{
+			struct thread *t = list_entry(list_pop_front(&dirty_list), struct thread, dirty_elem);
+			t->cpu_dirty = false;
+			mlfqs_update_priority(t);
+		}
+		preempt_priority();
+	}
+}
+
+/* Recomputes T's priority from its recent_cpu and nice values. */
+static void
+mlfqs_update_priority(struct thread *t)
+{
+	int priority = mlfqs_priority(t);
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	t->init_priority = priority;
+	thread_change_priority(t, priority);
+}
+
+/* Returns the priority T should have under the advanced
+   scheduler: PRI_MAX - (recent_cpu / 4) - (nice * 2), clamped to
+   the valid range. */
+static int
+mlfqs_priority(const struct thread *t)
+{
+	int priority = PRI_MAX - fp_to_int(t->recent_cpu / 4) - t->nice * 2;
+
+	if (priority < PRI_MIN)
+		return PRI_MIN;
+	if (priority > PRI_MAX)
+		return PRI_MAX;
+	return priority;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -521,6 +826,8 @@ kernel_thread(thread_func *function, void *aux)
 static void
 init_thread(struct thread *t, const char *name, int priority)
 {
+	enum intr_level old_level;
+
 	ASSERT(t != NULL);
 	ASSERT(PRI_MIN <= priority && priority <= PRI_MAX);
 	ASSERT(name != NULL);
@@ -535,6 +842,7 @@ init_thread(struct thread *t, const char *name, int priority)
 	t->init_priority = priority;
 	t->wait_on_lock = NULL;
 	list_init(&(t->donations));
+	t->wait_on_rwlock = NULL;
 
 	t->exit_status = 0;
 	t->next_fd = 2;
@@ -542,6 +850,12 @@ init_thread(struct thread *t, const char *name, int priority)
 	sema_init(&t->exit_sema, 0);
 	sema_init(&t->wait_sema, 0);
 	list_init(&(t->child_list));
+
+	t->nice = NICE_DEFAULT;
+	t->recent_cpu = fp_from_int(0);
+	old_level = intr_disable();
+	list_push_back(&all_list, &t->all_elem);
+	intr_set_level(old_level);
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
@@ -552,10 +866,47 @@ init_thread(struct thread *t, const char *name, int priority)
 static struct thread *
 next_thread_to_run(void)
 {
-	if (list_empty(&ready_list))
+	int priority = ready_queue_max_priority();
+	struct thread *t;
+
+	if (priority < 0)
 		return idle_thread;
-	else
-		return list_entry(list_pop_front(&ready_list), struct thread, elem);
+	t = list_entry(list_pop_front(&ready_queues[priority]), struct thread, elem);
+	if (list_empty(&ready_queues[priority]))
+		ready_bitmap &= ~(1ULL << priority);
+	ready_cnt--;
+	return t;
+}
+
+/* Appends T to the run queue of its current priority. */
+static void
+ready_queue_push(struct thread *t)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+	list_push_back(&ready_queues[t->priority], &t->elem);
+	ready_bitmap |= 1ULL << t->priority;
+	ready_cnt++;
+}
+
+/* Removes T, which must be in the run queue, from its level. */
+static void
+ready_queue_remove(struct thread *t)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+	list_remove(&t->elem);
+	if (list_empty(&ready_queues[t->priority]))
+		ready_bitmap &= ~(1ULL << t->priority);
+	ready_cnt--;
+}
+
+/* Returns the highest priority with a ready thread, or -1 if the
+   run queue is empty. */
+static int
+ready_queue_max_priority(void)
+{
+	if (ready_bitmap == 0)
+		return -1;
+	return 63 - __builtin_clzll(ready_bitmap);
 }
 
 /* Use iretq to launch the thread */
@@ -302,8 +302,6 @@ __do_fork(void *aux)
 	 * TODO:       from the fork() until this function successfully duplicates
 	 * TODO:       the resources of parent.*/
 	// FDT복사
-	if (!lock_held_by_current_thread(&filesys_lock))
-		lock_acquire(&filesys_lock);
 	for (int i = 0; i < FDT_COUNT; i++)
 	{
 		struct file *file = parent->fdt[i];
@@ -317,8 +315,6 @@ __do_fork(void *aux)
 		}
 		current->fdt[i] = file;
 	}
-	if (lock_held_by_current_thread(&filesys_lock))
-		lock_release(&filesys_lock);
 	current->next_fd = parent->next_fd;
 
 	// 로드가 완료될 때까지 기다리고 있던 부모 대기 해제
@@ -364,12 +360,7 @@ int process_exec(void *f_name)
 		count++;
 	}
 	/* And then load the binary */
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
 	success = load(file_name, &_if);
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
 
 	/* If load failed, quit. */
 
@@ -421,9 +412,6 @@ void process_exit(void)
 {
 	struct thread *curr = thread_current(); // 자식
 
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
 	for (int i = 2; i < FDT_COUNT; i++)
 	{
 		/* 현재 파일 디스크립터가 열린 상태인 경우 */
@@ -439,8 +427,6 @@ void process_exit(void)
 	file_close(curr->running);
 	process_cleanup();
 	hash_destroy(&curr->spt.spt_hash, NULL);
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
 	sema_down(&curr->exit_sema);
 }
 
@@ -826,17 +812,12 @@ lazy_load_segment(struct page *page, void *aux_)
 	uint32_t read_bytes = aux->read_bytes;
 	uint32_t zero_bytes = aux->zero_bytes;
 	free(aux);
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
 	file_seek(file, ofs);
 	if (file_read(file, page->frame->kva, read_bytes) != (int)read_bytes)
 	{
 		// error handle
 		return false;
 	}
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
 	memset(page->frame->kva + read_bytes, 0, zero_bytes);
 	return true;
 }
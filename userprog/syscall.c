@@ -1,5 +1,6 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
@@ -65,7 +66,6 @@ void syscall_init(void)
 	 * mode stack. Therefore, we masked the FLAG_FL. */
 	write_msr(MSR_SYSCALL_MASK,
 			  FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
-	lock_init(&filesys_lock);
 }
 
 /* The main system call interface */
@@ -211,9 +211,7 @@ bool create(const char *file, unsigned initial_size)
 	- initial_size: 생성할 파일 크기
 	*/
 	check_address(file);
-	lock_acquire(&filesys_lock);
 	bool success = filesys_create(file, initial_size);
-	lock_release(&filesys_lock);
 	return success;
 }
 
@@ -225,9 +223,7 @@ bool remove(const char *file)
 	- 성공 일 경우 true, 실패 일 경우 false 리턴
 	*/
 	check_address(file);
-	lock_acquire(&filesys_lock);
 	bool success = filesys_remove(file);
-	lock_release(&filesys_lock);
 	return success;
 }
 
@@ -238,13 +234,11 @@ int open(const char *file)
 {
 	check_address(file);
 	/* 파일을 open */
-	lock_acquire(&filesys_lock);
 	struct file *fileobj = filesys_open(file);
 
 	/* 해당 파일이 존재하지 않으면 -1 리턴 */
 	if (fileobj == NULL)
 	{
-		lock_release(&filesys_lock);
 		return -1;
 	}
 	/* 해당 파일 객체에 파일 디스크립터 부여 */
@@ -255,10 +249,34 @@ int open(const char *file)
 		file_close(fileobj);
 	}
 	/* 파일 디스크립터 리턴 */
-	lock_release(&filesys_lock);
 	return fd;
 }
 
+/*
+ * 유저 버퍼와 파일 사이에 바로 복사한다.
+ * inode 락을 잡은 채로 유저 버퍼에서 page fault가 나면 fault 처리 중
+ * frame_lock -> inode 락 순서로 락을 잡는 eviction과 교착될 수 있으므로,
+ * 파일 시스템 락을 잡기 전에 버퍼의 페이지를 모두 올려 고정해 둔다.
+ * 한 번의 file_read/file_write로 옮기므로 다른 writer에 대해 원자적이다.
+ */
+static off_t read_user(struct file *file, void *buffer, unsigned size)
+{
+	off_t bytes_read;
+	vm_pin_buffer(buffer, size, true);
+	bytes_read = file_read(file, buffer, size);
+	vm_unpin_buffer(buffer, size);
+	return bytes_read;
+}
+
+static off_t write_user(struct file *file, const void *buffer, unsigned size)
+{
+	off_t bytes_written;
+	vm_pin_buffer((void *)buffer, size, false);
+	bytes_written = file_write(file, buffer, size);
+	vm_unpin_buffer((void *)buffer, size);
+	return bytes_written;
+}
+
 /*
  * fd에 해당하는 파일을 찾고 그 파일의 크기를 반환한다.
  */
@@ -269,10 +287,7 @@ int filesize(int fd)
 	{
 		return -1;
 	}
-	lock_acquire(&filesys_lock);
-	int length = file_length(open_file);
-	lock_release(&filesys_lock);
-	return length;
+	return file_length(open_file);
 }
 /*
  * fd를 이용해서 파일 객체를 검색하고 입력을 버퍼에 저장하고, 버퍼에 저장한 크기를 반환
@@ -285,7 +300,6 @@ int read(int fd, void *buffer, unsigned size)
 		exit(-1);
 	off_t read_byte = 0;
 	uint8_t *read_buffer = (char *)buffer;
-	lock_acquire(&filesys_lock);
 	if (fd == 0)
 	{
 		char key;
@@ -301,7 +315,6 @@ int read(int fd, void *buffer, unsigned size)
 	}
 	else if (fd == 1)
 	{
-		lock_release(&filesys_lock);
 		return -1;
 	}
 	else
@@ -309,12 +322,10 @@ int read(int fd, void *buffer, unsigned size)
 		struct file *read_file = process_get_file(fd);
 		if (read_file == NULL)
 		{
-			lock_release(&filesys_lock);
 			return -1;
 		}
-		read_byte = file_read(read_file, buffer, size);
+		read_byte = read_user(read_file, buffer, size);
 	}
-	lock_release(&filesys_lock);
 	return read_byte;
 }
 
@@ -326,34 +337,28 @@ int write(int fd, const void *buffer, unsigned size)
 	check_address(buffer);
 	struct file *write_file = process_get_file(fd);
 	int bytes_write;
-	lock_acquire(&filesys_lock);
 	if (fd < 2)
 	{
 		if (fd == 1)
 		{
 			putbuf(buffer, size);
 			bytes_write = size;
-			lock_release(&filesys_lock);
 			return size;
 		}
-		lock_release(&filesys_lock);
 		return -1;
 	}
 	else
 	{
 		if (write_file == NULL)
 		{
-			lock_release(&filesys_lock);
 			return -1;
 		}
 		if (is_dir(write_file))
 		{
-			lock_release(&filesys_lock);
 			return -1;
 		}
-		bytes_write = file_write(write_file, buffer, size);
+		bytes_write = write_user(write_file, buffer, size);
 	}
-	lock_release(&filesys_lock);
 	return bytes_write;
 }
 
@@ -405,9 +410,7 @@ void close(int fd)
 	{
 		return;
 	}
-	lock_acquire(&filesys_lock);
 	file_close(close_file);
-	lock_release(&filesys_lock);
 	process_close_file(fd);
 }
 
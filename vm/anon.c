@@ -1,12 +1,29 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include <bitmap.h>
+#include "threads/malloc.h"
+#include "threads/mmu.h"
 #include "threads/vaddr.h"
 #include "devices/disk.h"
 
+/* Swap map: one bit per SLOT_SIZE-sector slot of the swap disk,
+   set while the slot holds a page.  Guarded by swap_lock.  It is
+   the only per-slot state: a swapped-out page records its slot
+   number, and the pages that share a slot after fork() are linked
+   to each other through out_elem in a ring without a head, so that
+   swapping out never allocates memory. */
+static struct bitmap *swap_map;
+static size_t swap_hint; /* Where the next free-slot search starts. */
+static struct lock_stats swap_lock_stats; /* Statistics of swap_lock. */
+
+static void swap_slots_alloc(size_t *, size_t cnt);
+static void swap_slot_free(size_t slot);
+static bool swap_map_pages(struct page *, struct frame *);
+static void swap_clear_pages(struct frame *);
+static void swap_unmap_pages(struct frame *, size_t slot);
+
 /* DO NOT MODIFY BELOW LINE */
-static struct list swap_slot_list;
-static char *zero_set[PGSIZE];
 static bool anon_swap_in(struct page *page, void *kva);
 static bool anon_swap_out(struct page *page);
 static void anon_destroy(struct page *page);
@@ -24,16 +41,59 @@ void vm_anon_init(void)
 {
 	/* TODO: Set up the swap_disk. */
 	swap_disk = disk_get(1, 1);
-	list_init(&swap_slot_list);
-	lock_init(&swap_lock);
-	for (int i = 0; i < disk_size(swap_disk); i += SLOT_SIZE)
+	lock_init_adaptive(&swap_lock, &swap_lock_stats, "swap_lock");
+	size_t slot_cnt = swap_disk != NULL ? disk_size(swap_disk) / SLOT_SIZE : 0;
+	swap_map = bitmap_create(slot_cnt);
+	if (swap_map == NULL)
+		PANIC("swap map creation failed");
+	swap_hint = 0;
+}
+
+/* Takes CNT free slots in a row, next-fit from the previous ones,
+   and returns the first, or BITMAP_ERROR if there is no such run.
+   swap_lock must be held. */
+static size_t
+swap_scan(size_t cnt)
+{
+	size_t idx = bitmap_scan_and_flip(swap_map, swap_hint, cnt, false);
+	if (idx == BITMAP_ERROR)
+		idx = bitmap_scan_and_flip(swap_map, 0, cnt, false); // 끝까지 없으면 처음부터
+	if (idx != BITMAP_ERROR)
+		swap_hint = idx + cnt;
+	return idx;
+}
+
+/* Takes CNT free swap slots into SLOTS, adjacent on disk if a long
+   enough run is free, one by one otherwise. */
+static void
+swap_slots_alloc(size_t *slots, size_t cnt)
+{
+	bool is_swap_lock = lock_held_by_current_thread(&swap_lock);
+	if (!is_swap_lock)
+		lock_acquire(&swap_lock);
+	size_t idx = swap_scan(cnt);
+	for (size_t i = 0; i < cnt; i++)
 	{
-		struct swap_slot *slot = malloc(sizeof(struct swap_slot));
-		list_init(&slot->page_list);
-		slot->start_sector = i;
-		list_push_back(&swap_slot_list, &slot->slot_elem);
+		size_t slot_idx = idx != BITMAP_ERROR ? idx + i : swap_scan(1);
+		if (slot_idx == BITMAP_ERROR)
+			PANIC("swap disk is full");
+		slots[i] = slot_idx;
 	}
-	memset(zero_set, 0, PGSIZE);
+	if (!is_swap_lock)
+		lock_release(&swap_lock);
+}
+
+/* Returns SLOT, which no page uses any more, to the swap map. The
+   old contents stay on disk; the next swap-out overwrites them. */
+static void
+swap_slot_free(size_t slot)
+{
+	bool is_swap_lock = lock_held_by_current_thread(&swap_lock);
+	if (!is_swap_lock)
+		lock_acquire(&swap_lock);
+	bitmap_reset(swap_map, slot);
+	if (!is_swap_lock)
+		lock_release(&swap_lock);
 }
 
 /* Initialize the file mapping */
@@ -47,52 +107,167 @@ bool anon_initializer(struct page *page, enum vm_type type, void *kva)
 		lock_acquire(&frame_lock);
 	struct anon_page *anon_page = &page->anon;
 	page->pml4 = thread_current()->pml4;
-	anon_page->slot = NULL;
+	anon_page->slot = SWAP_SLOT_NONE;
 	list_push_back(&page->frame->page_list, &page->out_elem);
 	if (!is_frame_lock)
 		lock_release(&frame_lock);
 	return true;
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Returns true if PAGE is the only page in its swap slot. */
+static bool
+swap_slot_alone(struct page *page)
+{
+	return page->out_elem.next == &page->out_elem;
+}
+
+/* Maps PAGE and every page sharing its swap slot to FRAME, which
+   holds the slot's contents, and takes them out of the slot.  A
+   page that another thread is swapping in already has a frame of
+   its own; it stays in the slot for that thread to map.  Returns
+   true if no page is left in the slot. */
+static bool
+swap_map_pages(struct page *page, struct frame *frame)
+{
+	struct list_elem *e = &page->out_elem;
+	size_t cnt = 1;
+	bool empty = true;
+	// 옮긴 페이지는 고리에서 빠지므로 먼저 수를 센다
+	for (struct list_elem *i = e->next; i != e; i = i->next)
+		cnt++;
+	while (cnt-- > 0)
+	{
+		struct page *in_page = list_entry(e, struct page, out_elem);
+		e = e->next;
+		if (in_page->frame != NULL && in_page->frame != frame)
+		{
+			empty = false;
+			continue;
+		}
+		list_remove(&in_page->out_elem);
+		in_page->frame = frame;
+		if (in_page->write_protected)
+			pml4_set_page(in_page->pml4, in_page->va, frame->kva, 0);
+		else
+			pml4_set_page(in_page->pml4, in_page->va, frame->kva, in_page->writable);
+		in_page->anon.slot = SWAP_SLOT_NONE;
+		frame->cnt_page += 1;
+		list_push_back(&frame->page_list, &in_page->out_elem);
+	}
+	return empty;
+}
+
+/* Clears the page table entry of every page sharing FRAME, so that
+   no process writes to FRAME while it is being written to swap. */
+static void
+swap_clear_pages(struct frame *frame)
+{
+	for (struct list_elem *e = list_begin(&frame->page_list); e != list_end(&frame->page_list); e = list_next(e))
+	{
+		struct page *out_page = list_entry(e, struct page, out_elem);
+		pml4_clear_page(out_page->pml4, out_page->va);
+	}
+}
+
+/* Moves every page sharing FRAME, already unmapped by
+   swap_clear_pages(), to SLOT, linked into one ring. */
+static void
+swap_unmap_pages(struct frame *frame, size_t slot)
+{
+	struct page *first = NULL;
+	while (!list_empty(&frame->page_list))
+	{
+		struct page *out_page = list_entry(list_pop_front(&frame->page_list), struct page, out_elem);
+		frame->cnt_page -= 1;
+		if (first == NULL)
+		{
+			first = out_page;
+			first->out_elem.prev = first->out_elem.next = &first->out_elem;
+		}
+		else
+			list_insert(&first->out_elem, &out_page->out_elem);
+		out_page->anon.slot = slot;
+		out_page->frame = NULL;
+	}
+}
+
+/* Puts NEWPAGE, a fork()ed copy of swapped-out PAGE, in PAGE's swap
+   slot.  frame_lock must be held. */
+void anon_share_slot(struct page *page, struct page *newpage)
+{
+	ASSERT(page->frame == NULL && page->anon.slot != SWAP_SLOT_NONE);
+	list_insert(&page->out_elem, &newpage->out_elem);
+	newpage->anon.slot = page->anon.slot;
+}
+
+/* Swap in the page by read contents from the swap disk.  Following
+   virtual pages that were swapped out to the following slots come
+   back in the same disk read, as long as more than vm_low_watermark
+   frames stay free, so that read-around never eats the reserve the
+   page-out daemon keeps for the next faults.  The frames are pinned
+   and frame_lock is dropped while the read is in flight; a page
+   whose frame is set is not mapped by anyone else meanwhile, so its
+   slot stays allocated until it is mapped here. */
 static bool
 anon_swap_in(struct page *page, void *kva)
 {
-	memset(kva, 0, PGSIZE);
-	struct anon_page *anon_page = &page->anon;
-	struct list *page_list = &anon_page->slot->page_list;
-	struct swap_slot *slot = anon_page->slot;
-	int read = 0;
+	struct page *pages[SWAP_CLUSTER];
+	size_t slots[SWAP_CLUSTER];
+	struct frame *frames[SWAP_CLUSTER];
+	struct disk_request reqs[SWAP_CLUSTER];
+	size_t cnt = 1;
+	// 이웃 페이지는 현재 프로세스의 것일 때만 찾아본다
+	if (page->pml4 == thread_current()->pml4)
+		while (cnt < SWAP_CLUSTER)
+		{
+			struct page *next = spt_find_page(&thread_current()->spt, page->va + cnt * PGSIZE);
+			if (next == NULL || VM_TYPE(next->operations->type) != VM_ANON)
+				break;
+			pages[cnt++] = next;
+		}
 	bool is_frame_lock = lock_held_by_current_thread(&frame_lock);
 	if (!is_frame_lock)
 		lock_acquire(&frame_lock);
-	while (!list_empty(page_list))
+	pages[0] = page;
+	slots[0] = page->anon.slot;
+	frames[0] = page->frame;
+	disk_request_init(&reqs[0], swap_disk, slots[0] * SLOT_SIZE, kva, SLOT_SIZE, false);
+	for (size_t i = 1; i < cnt; i++)
 	{
-		struct page *in_page = list_entry(list_pop_front(page_list), struct page, out_elem);
-		in_page->frame = page->frame;
-		if (in_page->write_protected)
-			pml4_set_page(in_page->pml4, in_page->va, page->frame->kva, 0);
-		else
-			pml4_set_page(in_page->pml4, in_page->va, page->frame->kva, in_page->writable);
-		if (read++ == 0)
+		struct page *next = pages[i];
+		if (next->frame != NULL || vm_writeback_pending(next)
+			|| next->anon.slot != slots[0] + i
+			|| palloc_free_cnt(PAL_USER) <= vm_low_watermark
+			|| (frames[i] = vm_try_get_frame()) == NULL)
 		{
-			for (int i = 0; i < SLOT_SIZE; i++)
-			{
-				disk_read(swap_disk, in_page->anon.slot->start_sector + i, in_page->frame->kva + DISK_SECTOR_SIZE * i);
-				disk_write(swap_disk, in_page->anon.slot->start_sector + i, zero_set + DISK_SECTOR_SIZE * i);
-			}
+			cnt = i;
+			break;
 		}
-		page->frame->cnt_page += 1;
-		list_push_back(&page->frame->page_list, &in_page->out_elem);
+		slots[i] = next->anon.slot;
+		frames[i]->pin_cnt++;
+		frames[i]->page = next;
+		next->frame = frames[i];
+		disk_request_init(&reqs[i], swap_disk, slots[i] * SLOT_SIZE, frames[i]->kva, SLOT_SIZE, false);
+	}
+	vm_wake_kswapd();
+	// 읽는 동안에는 다른 fault와 kswapd가 기다리지 않도록 frame_lock을 놓는다
+	if (!is_frame_lock)
+		lock_release(&frame_lock);
+	disk_submit_batch(reqs, cnt);
+	for (size_t i = 0; i < cnt; i++)
+		disk_wait(&reqs[i]);
+	if (!is_frame_lock)
+		lock_acquire(&frame_lock);
+	// 슬롯을 공유하는 페이지들은 읽기가 끝난 뒤에 매핑한다
+	for (size_t i = 0; i < cnt; i++)
+	{
+		if (swap_map_pages(pages[i], frames[i]))
+			swap_slot_free(slots[i]);
+		if (i > 0)
+			frames[i]->pin_cnt--; // frames[0]은 vm_do_claim_page()가 푼다
 	}
 	if (!is_frame_lock)
 		lock_release(&frame_lock);
-	bool is_swap_lock = lock_held_by_current_thread(&swap_lock);
-	if (!is_swap_lock)
-		lock_acquire(&swap_lock);
-	list_push_back(&swap_slot_list, &slot->slot_elem);
-	if (!is_swap_lock)
-		lock_release(&swap_lock);
 	return true;
 }
 
@@ -100,38 +275,77 @@ anon_swap_in(struct page *page, void *kva)
 static bool
 anon_swap_out(struct page *page)
 {
-	struct anon_page *anon_page = &page->anon;
-	bool is_swap_lock = lock_held_by_current_thread(&swap_lock);
-	if (!is_swap_lock)
-		lock_acquire(&swap_lock);
-	anon_page->slot = list_entry(list_pop_front(&swap_slot_list), struct swap_slot, slot_elem);
-	if (!is_swap_lock)
-		lock_release(&swap_lock);
 	bool is_frame_lock = lock_held_by_current_thread(&frame_lock);
 	if (!is_frame_lock)
 		lock_acquire(&frame_lock);
 	struct frame *frame = page->frame;
-	if (frame == NULL)
-		return true;
-	int dirty = 0;
-	while (!list_empty(&frame->page_list))
+	if (frame != NULL)
 	{
-		struct page *out_page = list_entry(list_pop_front(&frame->page_list), struct page, out_elem);
-		frame->cnt_page -= 1;
-		list_push_back(&anon_page->slot->page_list, &out_page->out_elem);
-		out_page->anon.slot = anon_page->slot;
-		for (int i = 0; i < SLOT_SIZE; i++)
-		{
-			disk_write(swap_disk, out_page->anon.slot->start_sector + i, out_page->frame->kva + DISK_SECTOR_SIZE * i);
-		}
-		pml4_clear_page(out_page->pml4, out_page->va);
-		out_page->frame = NULL;
+		size_t slot;
+		struct disk_request req;
+		swap_slots_alloc(&slot, 1);
+		// 기록을 내보내면 디스패처에게 곧바로 양보하므로, 그 전에 매핑을
+		// 모두 끊어야 기록 중인 프레임에 쓰는 일이 없다
+		swap_clear_pages(frame);
+		disk_request_init(&req, swap_disk, slot * SLOT_SIZE, frame->kva, SLOT_SIZE, true);
+		disk_submit(&req);
+		page->anon.slot = slot;
+		swap_unmap_pages(frame, slot);
+		disk_wait(&req);
 	}
 	if (!is_frame_lock)
 		lock_release(&frame_lock);
 	return true;
 }
 
+/* Swaps out the CNT pages in PAGES, at most SWAP_CLUSTER, which all
+   have frames.  They take adjacent swap slots in virtual address
+   order, so one merged disk write carries them all and a later
+   fault can read neighbours back together.  frame_lock must be
+   held. */
+void anon_swap_out_cluster(struct page **pages, size_t cnt)
+{
+	struct disk_request reqs[SWAP_CLUSTER];
+	anon_swap_out_submit(pages, cnt, reqs);
+	for (size_t i = 0; i < cnt; i++)
+		disk_wait(&reqs[i]);
+}
+
+/* Starts swapping out PAGES as anon_swap_out_cluster() does, with
+   the CNT disk requests in REQS, and returns without waiting for
+   them.  The pages are unmapped and moved to their slots on return;
+   their frames must stay allocated until every request in REQS is
+   done.  frame_lock must be held. */
+void anon_swap_out_submit(struct page **pages, size_t cnt, struct disk_request *reqs)
+{
+	size_t slots[SWAP_CLUSTER];
+	ASSERT(cnt <= SWAP_CLUSTER);
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	for (size_t i = 1; i < cnt; i++) // 프로세스별, 주소순으로 삽입 정렬
+	{
+		struct page *p = pages[i];
+		size_t j = i;
+		for (; j > 0 && (pages[j - 1]->pml4 > p->pml4
+						 || (pages[j - 1]->pml4 == p->pml4 && pages[j - 1]->va > p->va));
+			 j--)
+			pages[j] = pages[j - 1];
+		pages[j] = p;
+	}
+	swap_slots_alloc(slots, cnt);
+	// 프레임을 공유하는 페이지들의 내용은 같으므로 한 번만 기록한다.
+	// 기록을 내보내면 디스패처에게 곧바로 양보하므로 그 전에 모든
+	// 희생 페이지의 매핑을 끊고 정리해 둔다
+	for (size_t i = 0; i < cnt; i++)
+	{
+		struct frame *frame = pages[i]->frame;
+		disk_request_init(&reqs[i], swap_disk, slots[i] * SLOT_SIZE, frame->kva, SLOT_SIZE, true);
+		pages[i]->anon.slot = slots[i];
+		swap_clear_pages(frame);
+		swap_unmap_pages(frame, slots[i]);
+	}
+	disk_submit_batch(reqs, cnt);
+}
+
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy(struct page *page)
@@ -140,28 +354,21 @@ anon_destroy(struct page *page)
 	bool is_frame_lock = lock_held_by_current_thread(&frame_lock);
 	if (!is_frame_lock)
 		lock_acquire(&frame_lock);
+	vm_wait_writeback(page);
+	bool last = page->frame == NULL && swap_slot_alone(page);
 	list_remove(&page->out_elem);
 	if (page->frame != NULL)
 	{
 		page->frame->cnt_page -= 1;
 		if (page->frame->cnt_page == 0)
 		{
-			list_remove(&page->frame->frame_elem);
-			free(page->frame);
+			vm_frame_remove(page->frame);
 		}
 		else
 			pml4_clear_page(page->pml4, page->va);
 	}
-	else
-	{
-		bool is_swap_lock = lock_held_by_current_thread(&swap_lock);
-		if (!is_swap_lock)
-			lock_acquire(&swap_lock);
-		if (list_empty(&page->anon.slot->page_list))
-			list_push_back(&swap_slot_list, &page->anon.slot->slot_elem);
-		if (!is_swap_lock)
-			lock_release(&swap_lock);
-	}
+	else if (last)
+		swap_slot_free(page->anon.slot);
 	if (!is_frame_lock)
 		lock_release(&frame_lock);
 }
@@ -50,9 +50,6 @@ bool file_backed_initializer(struct page *page, enum vm_type type, void *kva)
 static bool
 file_backed_swap_in(struct page *page, void *kva)
 {
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
 	bool is_frame_lock = lock_held_by_current_thread(&frame_lock);
 	if (!is_frame_lock)
 		lock_acquire(&frame_lock);
@@ -69,8 +66,6 @@ file_backed_swap_in(struct page *page, void *kva)
 	free(file_list);
 	if (!is_frame_lock)
 		lock_release(&frame_lock);
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
 	return true;
 }
 
@@ -78,12 +73,27 @@ file_backed_swap_in(struct page *page, void *kva)
 static bool
 file_backed_swap_out(struct page *page)
 {
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
 	bool is_frame_lock = lock_held_by_current_thread(&frame_lock);
 	if (!is_frame_lock)
 		lock_acquire(&frame_lock);
+	void *kva = page->frame->kva;
+	struct page *writer = file_backed_unmap(page);
+	if (writer != NULL)
+		file_write_at(writer->file.file, kva, writer->file.read_bytes, writer->file.ofs);
+	if (!is_frame_lock)
+		lock_release(&frame_lock);
+	return true;
+}
+
+/* Unmaps every page sharing PAGE's frame and moves them to a new
+ * file list, as swap-out does, but leaves the write to the caller.
+ * Returns a page that was dirty, for which the frame's contents must
+ * be written back, or NULL if none was.  frame_lock must be held. */
+struct page *
+file_backed_unmap(struct page *page)
+{
+	struct page *writer = NULL;
+	ASSERT(lock_held_by_current_thread(&frame_lock));
 	struct file_page *file_page UNUSED = &page->file;
 	struct list *file_list = malloc(sizeof(struct list));
 	list_init(file_list);
@@ -93,16 +103,34 @@ file_backed_swap_out(struct page *page)
 	{
 		struct page *out_page = list_entry(list_pop_front(&frame->page_list), struct page, out_elem);
 		if (pml4_is_dirty(out_page->pml4, out_page->va))
-			file_write_at(out_page->file.file, out_page->frame->kva, out_page->file.read_bytes, out_page->file.ofs);
+			writer = out_page; // 프레임을 공유하는 페이지의 내용은 같다
 		list_push_back(file_list, &out_page->out_elem);
 		pml4_clear_page(out_page->pml4, out_page->va);
 		out_page->frame = NULL;
 	}
-	if (!is_frame_lock)
-		lock_release(&frame_lock);
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
-	return true;
+	return writer;
+}
+
+/* Marks every page sharing FRAME, which holds file-backed pages,
+ * clean, so that evicting FRAME later needs no write.  Returns a page
+ * that was dirty, for which the caller writes FRAME back, or NULL if
+ * none was.  frame_lock must be held. */
+struct page *
+file_backed_clean(struct frame *frame)
+{
+	struct page *writer = NULL;
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	// 기록하기 전에 지워야 기록 도중의 쓰기가 다시 dirty로 남는다
+	for (struct list_elem *e = list_begin(&frame->page_list); e != list_end(&frame->page_list); e = list_next(e))
+	{
+		struct page *page = list_entry(e, struct page, out_elem);
+		if (pml4_is_dirty(page->pml4, page->va))
+		{
+			pml4_set_dirty(page->pml4, page->va, false);
+			writer = page;
+		}
+	}
+	return writer;
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
@@ -110,12 +138,10 @@ static void
 file_backed_destroy(struct page *page)
 {
 	struct file_page *file_page UNUSED = &page->file;
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
 	bool is_frame_lock = lock_held_by_current_thread(&frame_lock);
 	if (!is_frame_lock)
 		lock_acquire(&frame_lock);
+	vm_wait_writeback(page);
 	list_remove(&page->out_elem);
 	if (page->frame == NULL)
 	{
@@ -133,14 +159,11 @@ file_backed_destroy(struct page *page)
 			pml4_clear_page(thread_current()->pml4, page->va);
 		else
 		{
-			list_remove(&page->frame->frame_elem);
-			free(page->frame);
+			vm_frame_remove(page->frame);
 		}
 	}
 	if (!is_frame_lock)
 		lock_release(&frame_lock);
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
 }
 
 static bool lazy_load(struct page *page, void *aux_)
@@ -151,13 +174,8 @@ static bool lazy_load(struct page *page, void *aux_)
 	uint32_t read_bytes = aux->read_bytes;
 	uint32_t zero_bytes = aux->zero_bytes;
 	free(aux);
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
 	file_seek(file, ofs);
 	read_bytes = file_read(file, page->frame->kva, read_bytes);
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
 
 	memset(page->frame->kva + read_bytes, 0, zero_bytes);
 	return true;
@@ -170,9 +188,6 @@ do_mmap(void *addr, size_t length, int writable,
 {
 	int cnt_page = length % PGSIZE ? length / PGSIZE + 1 : length / PGSIZE;
 	size_t length_ = length;
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
 	off_t ofs = file_length(file);
 	if (ofs < offset)
 		return NULL;
@@ -180,8 +195,6 @@ do_mmap(void *addr, size_t length, int writable,
 	{
 		if (spt_find_page(&thread_current()->spt, addr + i * PGSIZE) != NULL)
 		{
-			if (!is_lock_held)
-				lock_release(&filesys_lock);
 			return NULL;
 		}
 	}
@@ -203,8 +216,6 @@ do_mmap(void *addr, size_t length, int writable,
 
 		vm_alloc_page_with_initializer(VM_FILE, addr + i * PGSIZE, writable, lazy_load, aux);
 	}
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
 
 	return addr;
 }
@@ -221,15 +232,13 @@ void do_munmap(void *addr)
 		return;
 	length = page->file.file_length;
 	cnt_page = length % PGSIZE ? length / PGSIZE + 1 : length / PGSIZE;
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
 	bool is_frame_lock = lock_held_by_current_thread(&frame_lock);
 	if (!is_frame_lock)
 		lock_acquire(&frame_lock);
 	for (int i = 0; i < cnt_page; i++)
 	{
 		page = spt_find_page(&thread_current()->spt, addr + i * PGSIZE);
+		vm_wait_writeback(page);
 		if (VM_TYPE(page->operations->type) == VM_FILE && page->frame == NULL)
 		{
 			list_remove(&page->out_elem);
@@ -241,12 +250,12 @@ void do_munmap(void *addr)
 		}
 		page->frame->cnt_page -= 1;
 		file_close(page->file.file);
+		rwlock_acquire_write(&thread_current()->spt.spt_lock);
 		hash_delete(&thread_current()->spt.spt_hash, &page->page_elem);
+		rwlock_release(&thread_current()->spt.spt_lock);
 		list_remove(&page->out_elem);
 		pml4_clear_page(thread_current()->pml4, page->va);
 	}
 	if (!is_frame_lock)
 		lock_release(&frame_lock);
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
 }
@@ -1,5 +1,7 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <stdio.h>
+#include <string.h>
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
 #include "threads/mmu.h"
@@ -10,6 +12,53 @@
 #include "vm/file.h"
 #include "vm/anon.h"
 
+static struct lock_stats frame_lock_stats; /* Statistics of frame_lock. */
+
+/* Page-out daemon. */
+size_t vm_low_watermark = SIZE_MAX;	 /* SIZE_MAX: pick from pool size. */
+size_t vm_high_watermark = SIZE_MAX;
+static struct semaphore kswapd_sema; /* Up'd to wake the daemon. */
+static bool kswapd_awake;			 /* Woken and not done yet. */
+
+/* Most dirty file-backed frames cleaned per wake-up. */
+#define KSWAPD_CLEAN_MAX 16
+
+/* kswapd writes with frame_lock dropped.  Each batch it starts takes
+ * the next number, wb_started, and stamps it into the pages it
+ * writes; when the batch is done, wb_done catches up and wb_cond is
+ * broadcast.  A page stamped above wb_done must not be read back,
+ * destroyed or unmapped yet.  All guarded by frame_lock. */
+static unsigned long wb_started;
+static unsigned long wb_done;
+static struct condition wb_cond;
+
+static void vm_kswapd(void *aux);
+
+/* Frame table: a descriptor for every page of the user pool, so that
+ * finding the frame of a kva is an index and eviction scans an array.
+ * Guarded by frame_lock. */
+static struct frame *frame_table;
+static size_t frame_cnt;	   /* Entries in frame_table. */
+static uint8_t *frame_base;	   /* kva of frame_table[0]. */
+static size_t used_cnt;		   /* Frames in use. */
+static struct list cold_fifo; /* Frames in use and not hot, oldest first. */
+
+/* Page replacement.  The clock hands, indexes into frame_table, stay
+ * where the last eviction left them; hand_hot is used by CLOCK-Pro
+ * only.  hot_cnt counts the frames marked hot.  All guarded by
+ * frame_lock. */
+enum vm_policy vm_policy = VM_POLICY_CLOCK;
+static size_t hand;
+static size_t hand_hot;
+static size_t hot_cnt;
+
+/* Counters for vm_print_stats(). */
+static long long fault_cnt;	/* Page faults handled. */
+static long long major_cnt; /* Faults that read the page from disk. */
+static long long evict_cnt; /* Frames evicted. */
+
+static void frame_table_insert(struct frame *frame);
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void vm_init(void)
@@ -22,8 +71,26 @@ void vm_init(void)
 	register_inspect_intr();
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
-	list_init(&frame_table);
-	lock_init(&frame_lock);
+	lock_init_adaptive(&frame_lock, &frame_lock_stats, "frame_lock");
+	frame_base = palloc_pool_range(PAL_USER, &frame_cnt);
+	frame_table = calloc(frame_cnt, sizeof *frame_table);
+	if (frame_table == NULL)
+		PANIC("frame table allocation failed");
+	for (size_t i = 0; i < frame_cnt; i++)
+		frame_table[i].kva = frame_base + i * PGSIZE;
+	list_init(&cold_fifo);
+
+	size_t user_pages = palloc_free_cnt(PAL_USER);
+	if (vm_low_watermark == SIZE_MAX)
+		vm_low_watermark = user_pages / 64 + 1;
+	if (vm_high_watermark == SIZE_MAX)
+		vm_high_watermark = vm_low_watermark * 2;
+	if (vm_high_watermark < vm_low_watermark)
+		vm_high_watermark = vm_low_watermark;
+	sema_init(&kswapd_sema, 0);
+	cond_init(&wb_cond);
+	if (thread_create("kswapd", PRI_DEFAULT, vm_kswapd, NULL) == TID_ERROR)
+		PANIC("page-out daemon creation failed");
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -43,7 +110,7 @@ page_get_type(struct page *page)
 }
 
 /* Helpers */
-static struct frame *vm_get_victim(void);
+static size_t vm_get_victims(struct frame **victims, size_t max);
 static bool vm_do_claim_page(struct page *page);
 static struct frame *vm_evict_frame(void);
 
@@ -96,7 +163,12 @@ spt_find_page(struct supplemental_page_table *spt UNUSED, void *va UNUSED)
 	/* TODO: Fill this function. */
 	struct page tmp;
 	tmp.va = va;
+	bool is_spt_lock = rwlock_held_by_current_thread(&spt->spt_lock);
+	if (!is_spt_lock)
+		rwlock_acquire_read(&spt->spt_lock); // page fault마다 불리므로 공유 모드로 조회
 	struct hash_elem *h = hash_find(&spt->spt_hash, &(tmp.page_elem));
+	if (!is_spt_lock)
+		rwlock_release(&spt->spt_lock);
 	if (h == NULL)
 	{
 		return NULL;
@@ -111,8 +183,13 @@ bool spt_insert_page(struct supplemental_page_table *spt UNUSED,
 					 struct page *page UNUSED)
 {
 	int succ = false;
+	bool is_spt_lock = rwlock_held_by_current_thread(&spt->spt_lock);
+	if (!is_spt_lock)
+		rwlock_acquire_write(&spt->spt_lock);
 	if (hash_insert(&spt->spt_hash, &page->page_elem) == NULL)
 		succ = true;
+	if (!is_spt_lock)
+		rwlock_release(&spt->spt_lock);
 	return succ;
 }
 
@@ -122,76 +199,506 @@ void spt_remove_page(struct supplemental_page_table *spt, struct page *page)
 	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Selects the replacement policy named NAME.  Returns false if there
+ * is no such policy. */
+bool vm_set_policy(const char *name)
+{
+	if (name == NULL)
+		return false;
+	if (!strcmp(name, "clock"))
+		vm_policy = VM_POLICY_CLOCK;
+	else if (!strcmp(name, "clockpro"))
+		vm_policy = VM_POLICY_CLOCKPRO;
+	else if (!strcmp(name, "2q"))
+		vm_policy = VM_POLICY_2Q;
+	else
+		return false;
+	return true;
+}
+
+/* Prints paging statistics. */
+void vm_print_stats(void)
+{
+	static const char *names[] = {"clock", "clockpro", "2q"};
+	printf("VM: %s replacement, %lld faults, %lld from disk, %lld evictions\n",
+		   names[vm_policy], fault_cnt, major_cnt, evict_cnt);
+}
+
+/* Returns the frame table entry for KVA, a user pool page. */
 static struct frame *
-vm_get_victim(void)
+frame_of(void *kva)
+{
+	size_t idx = ((uint8_t *)kva - frame_base) >> PGBITS;
+	ASSERT(idx < frame_cnt);
+	return &frame_table[idx];
+}
+
+/* Marks FRAME in use as a new, cold frame. */
+static void
+frame_table_insert(struct frame *frame)
+{
+	ASSERT(!frame->in_use);
+	frame->in_use = true;
+	frame->hot = false;
+	list_push_back(&cold_fifo, &frame->frame_elem);
+	used_cnt++;
+}
+
+/* Marks FRAME hot. */
+static void
+frame_make_hot(struct frame *frame)
 {
-	struct frame *victim = NULL;
+	list_remove(&frame->frame_elem);
+	frame->hot = true;
+	hot_cnt++;
+}
+
+/* Takes FRAME out of use.  frame_lock must be held. */
+void vm_frame_remove(struct frame *frame)
+{
+	ASSERT(frame->in_use);
+	if (frame->hot)
+		hot_cnt--;
+	else
+		list_remove(&frame->frame_elem);
+	frame->in_use = false;
+	used_cnt--;
+}
+
+/* Returns the frame under *H and moves *H to the next one, wrapping
+ * around the frame table. */
+static struct frame *
+hand_advance(size_t *h)
+{
+	struct frame *frame = &frame_table[*h];
+	*h = (*h + 1) % frame_cnt;
+	return frame;
+}
+
+/* Returns true if FRAME may be evicted now. */
+static bool
+frame_evictable(struct frame *frame)
+{
+	return frame->in_use && frame->pin_cnt == 0 && !list_empty(&frame->page_list);
+}
+
+/* Returns true if any page sharing FRAME was accessed since the last
+ * check, clearing the accessed bits if CLEAR. */
+static bool
+frame_accessed(struct frame *frame, bool clear)
+{
+	bool accessed = false;
+	for (struct list_elem *e = list_begin(&frame->page_list); e != list_end(&frame->page_list); e = list_next(e))
+	{
+		struct page *page = list_entry(e, struct page, out_elem);
+		if (pml4_is_accessed(page->pml4, page->va))
+		{
+			accessed = true;
+			if (clear)
+				pml4_set_accessed(page->pml4, page->va, false);
+		}
+	}
+	return accessed;
+}
+
+/* Returns true if evicting FRAME needs a write.  An anonymous frame
+ * always goes to swap; a file-backed one only if dirty. */
+static bool
+frame_dirty(struct frame *frame)
+{
+	struct page *page = list_entry(list_front(&frame->page_list), struct page, out_elem);
+	if (VM_TYPE(page->operations->type) != VM_FILE)
+		return true;
+	for (struct list_elem *e = list_begin(&frame->page_list); e != list_end(&frame->page_list); e = list_next(e))
+	{
+		page = list_entry(e, struct page, out_elem);
+		if (pml4_is_dirty(page->pml4, page->va))
+			return true;
+	}
+	return false;
+}
+
+/* Clock with dirty-aware second chances (enhanced second chance),
+ * collecting up to MAX victims, at most SWAP_CLUSTER, into VICTIMS
+ * and taking them off the frame table.  The first lap clears nothing.
+ * It takes frames that are neither accessed nor dirty and sets aside
+ * the ones that are only dirty.  It ends once MAX frames of either
+ * kind are found, and the dirty ones fill what is left of the cluster.
+ * So an all-anonymous workload, where every frame is dirty, stops
+ * after MAX frames not accessed instead of walking the whole table.
+ * Only if the first lap finds nothing do two more laps clear accessed
+ * bits as they pass and take frames not accessed since. */
+static size_t
+clock_victims(size_t n, struct frame **victims, size_t max)
+{
+	struct frame *dirty[SWAP_CLUSTER];
+	size_t cnt = 0, dirty_cnt = 0;
+
+	ASSERT(max <= SWAP_CLUSTER);
+	for (size_t i = 0; i < n && cnt < max && dirty_cnt < max; i++)
+	{
+		struct frame *frame = hand_advance(&hand);
+		if (!frame_evictable(frame) || frame_accessed(frame, false))
+			continue;
+		if (frame_dirty(frame))
+			dirty[dirty_cnt++] = frame;
+		else
+		{
+			vm_frame_remove(frame);
+			victims[cnt++] = frame;
+		}
+	}
+	for (size_t i = 0; i < dirty_cnt && cnt < max; i++)
+	{
+		vm_frame_remove(dirty[i]);
+		victims[cnt++] = dirty[i];
+	}
+	for (int lap = 1; lap < 3 && cnt == 0; lap++)
+		for (size_t i = 0; i < n && cnt < max; i++)
+		{
+			struct frame *frame = hand_advance(&hand);
+			if (frame_evictable(frame) && !frame_accessed(frame, true))
+			{
+				vm_frame_remove(frame); // 다음 바퀴에서 다시 고르지 않도록
+				victims[cnt++] = frame;
+			}
+		}
+	return cnt;
+}
+
+/* CLOCK-Pro's hot hand: turns hot frames not accessed since it last
+ * passed them cold until at most TARGET frames are hot. */
+static void
+clockpro_cool(size_t n, size_t target)
+{
+	for (size_t i = 0; i < 2 * n && hot_cnt > target; i++)
+	{
+		struct frame *frame = hand_advance(&hand_hot);
+		if (!frame->hot || !frame_evictable(frame) || frame_accessed(frame, true))
+			continue;
+		frame->hot = false;
+		hot_cnt--;
+		list_push_back(&cold_fifo, &frame->frame_elem);
+	}
+}
+
+/* CLOCK-Pro without non-resident entries: the cold hand evicts cold
+ * frames not accessed since it last passed them and turns accessed
+ * ones hot; the hot hand keeps three quarters of the frames hot at
+ * most, so a burst of pages used once cannot push out a working set
+ * used again and again. */
+static struct frame *
+clockpro_victim(size_t n)
+{
+	size_t target = used_cnt - used_cnt / 4;
+	clockpro_cool(n, target);
+	for (size_t i = 0; i < 3 * n; i++)
+	{
+		struct frame *frame = hand_advance(&hand);
+		if (frame->hot || !frame_evictable(frame))
+			continue;
+		if (!frame_accessed(frame, true))
+			return frame;
+		frame_make_hot(frame);
+		clockpro_cool(n, target);
+	}
+	return NULL;
+}
+
+/* Simplified 2Q: frames that were never accessed again after their
+ * fault sit in a FIFO (A1) that may hold a quarter of the frames;
+ * reused frames (Am, marked hot) are replaced by clock.  Frames
+ * accessed while in A1 move to Am. */
+static struct frame *
+twoq_victim(size_t n)
+{
+	if (used_cnt - hot_cnt > used_cnt / 4 || hot_cnt == 0)
+		for (struct list_elem *e = list_begin(&cold_fifo); e != list_end(&cold_fifo);)
+		{
+			struct frame *frame = list_entry(e, struct frame, frame_elem);
+			e = list_next(e);
+			if (!frame_evictable(frame))
+				continue;
+			if (!frame_accessed(frame, true))
+				return frame;
+			frame_make_hot(frame);
+		}
+	for (size_t i = 0; i < 2 * n; i++)
+	{
+		struct frame *frame = hand_advance(&hand);
+		if (!frame_evictable(frame))
+			continue;
+		if (!frame_accessed(frame, true))
+			return frame;
+	}
+	return NULL;
+}
+
+/* Picks up to MAX frames to evict, at most SWAP_CLUSTER, takes them
+ * off the frame table and stores them in VICTIMS.  Returns how many
+ * were picked, 0 if no frame can be evicted.  frame_lock must be
+ * held. */
+static size_t
+vm_get_victims(struct frame **victims, size_t max)
+{
+	struct frame *victim;
+	size_t cnt = 0;
 	/* TODO: The policy for eviction is up to you. */
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	if (used_cnt == 0)
+		return 0;
+	switch (vm_policy)
+	{
+	case VM_POLICY_CLOCK:
+		return clock_victims(frame_cnt, victims, max);
+	case VM_POLICY_CLOCKPRO:
+		while (cnt < max && (victim = clockpro_victim(frame_cnt)) != NULL)
+		{
+			vm_frame_remove(victim);
+			victims[cnt++] = victim;
+		}
+		break;
+	case VM_POLICY_2Q:
+		while (cnt < max && (victim = twoq_victim(frame_cnt)) != NULL)
+		{
+			vm_frame_remove(victim);
+			victims[cnt++] = victim;
+		}
+		break;
+	}
+	return cnt;
+}
+
+/* Evict a cluster of up to SWAP_CLUSTER pages and return one of the
+ * freed frames, taken off the frame table, or NULL if no frame can be
+ * evicted.  Anonymous victims go out to adjacent swap slots in one
+ * disk write.  The other frames go back to the user pool, a reserve
+ * that the next few faults take without evicting again. */
+static struct frame *
+vm_evict_frame(void)
+{
+	struct frame *victims[SWAP_CLUSTER];
+	struct page *anon[SWAP_CLUSTER];
+	size_t cnt = 0, anon_cnt = 0;
 	bool is_frame_lock = lock_held_by_current_thread(&frame_lock);
 	if (!is_frame_lock)
 		lock_acquire(&frame_lock);
-	for (struct list_elem *e = list_begin(&frame_table); e != list_end(&frame_table); e = list_next(e))
+	cnt = vm_get_victims(victims, SWAP_CLUSTER);
+	for (size_t i = 0; i < cnt; i++)
 	{
-		struct frame *frame = list_entry(e, struct frame, frame_elem);
-		if (!pml4_is_accessed(frame->page->pml4, frame->page->va))
-		{
-			if (!is_frame_lock)
-				lock_release(&frame_lock);
-			return frame;
-		}
+		struct page *page = list_entry(list_front(&victims[i]->page_list), struct page, out_elem);
+		if (VM_TYPE(page->operations->type) == VM_ANON)
+			anon[anon_cnt++] = page;
 		else
-			pml4_set_accessed(frame->page->pml4, frame->page->va, 0);
+			swap_out(page);
 	}
+	evict_cnt += cnt;
+	if (anon_cnt > 0)
+		anon_swap_out_cluster(anon, anon_cnt);
+	for (size_t i = 1; i < cnt; i++)
+		palloc_free_page(victims[i]->kva);
 	if (!is_frame_lock)
 		lock_release(&frame_lock);
-	return list_entry(list_front(&frame_table), struct frame, frame_elem);
+	return cnt > 0 ? victims[0] : NULL;
 }
 
-/* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
-static struct frame *
-vm_evict_frame(void)
+/* palloc() and get frame without evicting. Return NULL if the user
+ * pool is empty. */
+struct frame *
+vm_try_get_frame(void)
 {
-	struct frame *victim = vm_get_victim();
-	/* TODO: swap out the victim and return the evicted frame. */
-
-	return victim;
+	void *upage = palloc_get_page(PAL_USER | PAL_ZERO);
+	if (upage == NULL)
+		return NULL;
+	struct frame *frame = frame_of(upage);
+	frame->page = NULL;
+	frame->pin_cnt = 0;
+	frame_table_insert(frame);
+	list_init(&frame->page_list);
+	frame->cnt_page = 1;
+	return frame;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * space. The frame comes back pinned; the caller unpins it once it holds
+ * the page. frame_lock must be held. */
 static struct frame *
 vm_get_frame(void)
 {
-	struct frame *frame = NULL;
-	frame = calloc(1, sizeof(struct frame));
-	void *upage = palloc_get_page(PAL_USER | PAL_ZERO);
-	if (upage == NULL)
+	struct frame *frame = vm_try_get_frame();
+	if (frame == NULL)
 	{
-		free(frame);
 		frame = vm_evict_frame();
-		swap_out(frame->page);
-		list_remove(&frame->frame_elem);
-		list_push_back(&frame_table, &frame->frame_elem);
-		frame->page = NULL;
-	}
-	else
-	{
+		if (frame == NULL)
+			PANIC("no frame to evict");
+		frame_table_insert(frame);
 		frame->page = NULL;
-		frame->kva = upage;
-		list_push_back(&frame_table, &frame->frame_elem);
-		list_init(&frame->page_list);
-		frame->cnt_page = 1;
 	}
+	frame->pin_cnt++;
+	vm_wake_kswapd();
 
 	ASSERT(frame != NULL);
 	ASSERT(frame->page == NULL);
 	return frame;
 }
 
+/* Wakes the page-out daemon if free user frames are below
+ * vm_low_watermark.  frame_lock must be held. */
+void vm_wake_kswapd(void)
+{
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	if (palloc_free_cnt(PAL_USER) < vm_low_watermark && !kswapd_awake)
+	{
+		kswapd_awake = true;
+		sema_up(&kswapd_sema);
+	}
+}
+
+/* Waits until kswapd has finished writing PAGE out, if it is doing
+ * so.  frame_lock must be held; it is released while waiting. */
+void vm_wait_writeback(struct page *page)
+{
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	while (page->wb_seq > wb_done)
+		cond_wait(&wb_cond, &frame_lock);
+}
+
+/* Returns true if kswapd is writing PAGE out.  frame_lock must be
+ * held. */
+bool vm_writeback_pending(const struct page *page)
+{
+	return page->wb_seq > wb_done;
+}
+
+/* Stamps every page sharing FRAME with kswapd batch SEQ. */
+static void
+writeback_mark(struct frame *frame, unsigned long seq)
+{
+	for (struct list_elem *e = list_begin(&frame->page_list); e != list_end(&frame->page_list); e = list_next(e))
+		list_entry(e, struct page, out_elem)->wb_seq = seq;
+}
+
+/* Ends kswapd batch SEQ and wakes the threads waiting for its pages.
+ * frame_lock must be held. */
+static void
+writeback_end(unsigned long seq)
+{
+	wb_done = seq;
+	cond_broadcast(&wb_cond, &frame_lock);
+}
+
+/* Evicts one cluster for kswapd.  The victims are picked and
+ * unmapped under frame_lock, which is dropped while they are written
+ * to swap or back to their files, so faults do not wait behind the
+ * writes.  Returns false if no frame could be evicted. */
+static bool
+kswapd_evict(void)
+{
+	struct frame *victims[SWAP_CLUSTER];
+	struct page *anon[SWAP_CLUSTER];
+	struct page *writers[SWAP_CLUSTER];
+	void *kvas[SWAP_CLUSTER];
+	struct disk_request reqs[SWAP_CLUSTER];
+	size_t cnt, anon_cnt = 0, write_cnt = 0;
+
+	lock_acquire(&frame_lock);
+	cnt = vm_get_victims(victims, SWAP_CLUSTER);
+	if (cnt == 0)
+	{
+		lock_release(&frame_lock);
+		return false;
+	}
+	unsigned long seq = ++wb_started;
+	for (size_t i = 0; i < cnt; i++)
+	{
+		struct page *page = list_entry(list_front(&victims[i]->page_list), struct page, out_elem);
+		writeback_mark(victims[i], seq);
+		if (VM_TYPE(page->operations->type) == VM_ANON)
+			anon[anon_cnt++] = page;
+		else if ((writers[write_cnt] = file_backed_unmap(page)) != NULL)
+			kvas[write_cnt++] = victims[i]->kva;
+	}
+	evict_cnt += cnt;
+	if (anon_cnt > 0)
+		anon_swap_out_submit(anon, anon_cnt, reqs);
+	lock_release(&frame_lock);
+
+	for (size_t i = 0; i < anon_cnt; i++)
+		disk_wait(&reqs[i]);
+	for (size_t i = 0; i < write_cnt; i++)
+		file_write_at(writers[i]->file.file, kvas[i], writers[i]->file.read_bytes, writers[i]->file.ofs);
+	for (size_t i = 0; i < cnt; i++)
+		palloc_free_page(victims[i]->kva);
+
+	lock_acquire(&frame_lock);
+	writeback_end(seq);
+	lock_release(&frame_lock);
+	return true;
+}
+
+/* Writes back up to KSWAPD_CLEAN_MAX dirty file-backed frames, the
+ * ones the clock hand reaches next that were not accessed since it
+ * last passed them, so that evicting them later needs no write.  The
+ * frames stay pinned while frame_lock is dropped for the writes. */
+static void
+kswapd_clean(void)
+{
+	struct frame *frames[KSWAPD_CLEAN_MAX];
+	struct page *writers[KSWAPD_CLEAN_MAX];
+	size_t cnt = 0;
+	size_t h;
+
+	lock_acquire(&frame_lock);
+	unsigned long seq = ++wb_started;
+	h = hand;
+	for (size_t i = 0; i < frame_cnt && cnt < KSWAPD_CLEAN_MAX; i++)
+	{
+		struct frame *frame = hand_advance(&h);
+		if (!frame_evictable(frame) || frame_accessed(frame, false))
+			continue;
+		struct page *page = list_entry(list_front(&frame->page_list), struct page, out_elem);
+		if (VM_TYPE(page->operations->type) != VM_FILE || (writers[cnt] = file_backed_clean(frame)) == NULL)
+			continue;
+		writeback_mark(frame, seq);
+		frame->pin_cnt++;
+		frames[cnt++] = frame;
+	}
+	lock_release(&frame_lock);
+
+	for (size_t i = 0; i < cnt; i++)
+		file_write_at(writers[i]->file.file, frames[i]->kva, writers[i]->file.read_bytes, writers[i]->file.ofs);
+
+	lock_acquire(&frame_lock);
+	for (size_t i = 0; i < cnt; i++)
+		frames[i]->pin_cnt--;
+	writeback_end(seq);
+	lock_release(&frame_lock);
+}
+
+/* Page-out daemon.  Woken when free user frames drop below
+ * vm_low_watermark, it evicts clusters of cold pages until
+ * vm_high_watermark frames are free, so that faults find a free frame
+ * without waiting on a swap write.  Then it writes back a few dirty
+ * file-backed frames, which later evictions can drop without writing.
+ * frame_lock is never held across a write. */
+static void
+vm_kswapd(void *aux UNUSED)
+{
+	for (;;)
+	{
+		sema_down(&kswapd_sema);
+		while (palloc_free_cnt(PAL_USER) < vm_high_watermark)
+			if (!kswapd_evict())
+				break;
+		kswapd_clean();
+		lock_acquire(&frame_lock);
+		kswapd_awake = false;
+		lock_release(&frame_lock);
+	}
+}
+
 /* Growing the stack. */
 static void
 vm_stack_growth(void *addr UNUSED)
@@ -218,21 +725,77 @@ vm_handle_wp(struct page *page UNUSED)
 		left_page->write_protected = false;
 	}
 	list_remove(&page->out_elem);
+	origin->pin_cnt++; // 복사가 끝나기 전에 origin이 쫓겨나지 않도록
 	struct frame *frame = vm_get_frame();
 	memset(frame->kva, 0, PGSIZE);
-	list_push_back(&frame_table, &frame->frame_elem);
 	page->frame = frame;
 	frame->page = page;
 	frame->cnt_page = 1;
 	page->write_protected = false;
 	pml4_set_page(page->pml4, page->va, frame->kva, 1);
 	memcpy(frame->kva, origin->kva, PGSIZE);
+	origin->pin_cnt--;
+	frame->pin_cnt--;
 	if (!is_frame_lock)
 		lock_release(&frame_lock);
 
 	return true;
 }
 
+/* Faults in every page of the SIZE bytes at user address BUFFER,
+ * copying shared copy-on-write pages first if WRITE, and pins their
+ * frames, so that the kernel can then touch BUFFER while it holds
+ * file system locks without faulting.  A bad address kills the
+ * process, as a fault on it from user mode would.  Each page is
+ * touched through the ordinary fault path and pinned only if it
+ * is still resident afterward. */
+void vm_pin_buffer(void *buffer, size_t size, bool write)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	uint8_t *end = (uint8_t *)buffer + size;
+
+	for (uint8_t *va = pg_round_down(buffer); va < end; va += PGSIZE)
+	{
+		volatile uint8_t *p = va < (uint8_t *)buffer ? buffer : va;
+		struct page *page;
+		bool pinned = false;
+
+		while (!pinned)
+		{
+			if (write)
+				*p = *p; // write fault로 COW도 여기서 풀어 둔다
+			else
+				(void)*p;
+			page = spt_find_page(spt, va);
+			ASSERT(page != NULL);
+			lock_acquire(&frame_lock);
+			if (page->frame != NULL && !(write && page->write_protected))
+			{
+				page->frame->pin_cnt++;
+				pinned = true;
+			}
+			lock_release(&frame_lock);
+		}
+	}
+}
+
+/* Unpins the frames that vm_pin_buffer() pinned for the SIZE bytes
+ * at BUFFER. */
+void vm_unpin_buffer(void *buffer, size_t size)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	uint8_t *end = (uint8_t *)buffer + size;
+
+	for (uint8_t *va = pg_round_down(buffer); va < end; va += PGSIZE)
+	{
+		struct page *page = spt_find_page(spt, va);
+
+		lock_acquire(&frame_lock);
+		page->frame->pin_cnt--;
+		lock_release(&frame_lock);
+	}
+}
+
 /* Return true on success */
 bool vm_try_handle_fault(struct intr_frame *f UNUSED, void *addr UNUSED,
 						 bool user UNUSED, bool write UNUSED, bool not_present UNUSED)
@@ -240,6 +803,7 @@ bool vm_try_handle_fault(struct intr_frame *f UNUSED, void *addr UNUSED,
 	struct supplemental_page_table *spt UNUSED = &thread_current()->spt;
 	struct page *page = NULL;
 	uint64_t user_rsp = f->rsp;
+	fault_cnt++;
 	if (!user)
 		user_rsp = thread_current()->user_rsp;
 	if (not_present)
@@ -305,6 +869,7 @@ vm_do_claim_page(struct page *page)
 	bool is_frame_lock = lock_held_by_current_thread(&frame_lock);
 	if (!is_frame_lock)
 		lock_acquire(&frame_lock);
+	vm_wait_writeback(page);
 	struct frame *frame = vm_get_frame();
 	struct thread *curr = thread_current();
 
@@ -319,13 +884,17 @@ vm_do_claim_page(struct page *page)
 			PANIC("FAIL");
 		break;
 	case VM_ANON:
-		break;
 	case VM_FILE:
+		major_cnt++; // 스왑이나 파일에서 다시 읽어 온다
 		break;
 	}
 	if (!is_frame_lock)
 		lock_release(&frame_lock);
-	return swap_in(page, frame->kva);
+	bool success = swap_in(page, frame->kva);
+	lock_acquire(&frame_lock); // pin_cnt는 frame_lock이 지킨다
+	frame->pin_cnt--;
+	lock_release(&frame_lock);
+	return success;
 }
 
 /* Initialize new supplemental page table */
@@ -345,6 +914,7 @@ unsigned int hash_va(const struct hash_elem *p, void *aux UNUSED)
 void supplemental_page_table_init(struct supplemental_page_table *spt UNUSED)
 {
 	hash_init(&spt->spt_hash, hash_va, hash_page_less, NULL);
+	rwlock_init(&spt->spt_lock);
 }
 
 /* Copy supplemental page table from src to dst */
@@ -354,15 +924,13 @@ bool supplemental_page_table_copy(struct supplemental_page_table *dst UNUSED,
 	struct hash_iterator i;
 	struct page *newpage;
 	void *aux;
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
 	bool is_frame_lock = lock_held_by_current_thread(&frame_lock);
 	if (!is_frame_lock)
 		lock_acquire(&frame_lock);
 	bool is_swap_lock = lock_held_by_current_thread(&swap_lock);
 	if (!is_swap_lock)
 		lock_acquire(&swap_lock);
+	rwlock_acquire_read(&src->spt_lock); // 부모의 spt는 읽기만 한다
 	hash_first(&i, &src->spt_hash);
 	while (hash_next(&i))
 	{
@@ -381,8 +949,7 @@ bool supplemental_page_table_copy(struct supplemental_page_table *dst UNUSED,
 			spt_insert_page(dst, newpage);
 			if (page->frame == NULL)
 			{
-				list_push_back(&page->anon.slot->page_list, &newpage->out_elem);
-				newpage->anon.slot = page->anon.slot;
+				anon_share_slot(page, newpage);
 				if (page->writable == 1)
 				{
 					page->write_protected = true;
@@ -422,6 +989,7 @@ bool supplemental_page_table_copy(struct supplemental_page_table *dst UNUSED,
 			newpage->file.ofs = page->file.ofs;
 			newpage->file.read_bytes = page->file.read_bytes;
 			newpage->file.zero_bytes = page->file.zero_bytes;
+			newpage->wb_seq = page->wb_seq;
 			if (page->frame == NULL)
 			{
 				newpage->frame = NULL;
@@ -437,12 +1005,11 @@ bool supplemental_page_table_copy(struct supplemental_page_table *dst UNUSED,
 			break;
 		}
 	}
+	rwlock_release(&src->spt_lock);
 	if (!is_swap_lock)
 		lock_release(&swap_lock);
 	if (!is_frame_lock)
 		lock_release(&frame_lock);
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
 	return true;
 }
 
@@ -457,5 +1024,7 @@ void supplemental_page_table_kill(struct supplemental_page_table *spt UNUSED)
 {
 	/* TODO: Destroy all the supplemental_page_table hold by thread and
 	 * TODO: writeback all the modified contents to the storage. */
+	rwlock_acquire_write(&spt->spt_lock);
 	hash_clear(&spt->spt_hash, clear_page_hash);
+	rwlock_release(&spt->spt_lock);
 }